@@ -0,0 +1,142 @@
+#include "kilo.h"
+
+/*** arena ***/
+/*
+The text of the rows (chars and render) is allocated from an arena instead of one malloc per block.
+The arena carves blocks out of big chunks, rounded up to a size class: multiples of 16 bytes up to 256,
+then four classes per power of two up to ARENA_MAX_CLASS. A freed block goes on the free list of its class
+and is handed out again by the next allocation of that class, so blocks carry no header at all.
+Blocks larger than the biggest class are malloc'd, but the arena keeps them in a list too,
+so closing a file frees everything in O(chunks) instead of once per row.
+The caller passes the size of a block back when freeing it, rows keep it in erow.cap.
+An arena is not thread safe, only the main thread allocates row text.
+A zeroed struct arena is an empty arena.
+*/
+
+#define ARENA_MAX_CLASS 4096 // largest block served from the chunks
+
+struct arenaChunk {
+  struct arenaChunk *next;
+  size_t pad; // keeps the blocks after the header 16 byte aligned
+};
+
+struct arenaBig {
+  struct arenaBig *prev;
+  struct arenaBig *next;
+  size_t size;
+  size_t pad;
+};
+
+// size class of an n byte block
+static int arenaClass(size_t n) {
+  if (n <= 256) return n == 0 ? 0 : (n + 15) / 16 - 1;
+  int b = 63 - __builtin_clzll(n - 1); // n - 1 has its highest bit at b, so 2^b < n <= 2^(b+1)
+  size_t step = (size_t)1 << (b - 2);
+  return 16 + (b - 8) * 4 + (int)((n + step - 1) / step) - 5;
+}
+
+// bytes in a block of class c
+static size_t arenaClassSize(int c) {
+  if (c < 16) return (size_t)(c + 1) * 16;
+  int b = 8 + (c - 16) / 4;
+  return (size_t)(5 + (c - 16) % 4) << (b - 2);
+}
+
+// the bytes actually reserved for an n byte request
+size_t arenaBlockSize(size_t n) {
+  return n > ARENA_MAX_CLASS ? n : arenaClassSize(arenaClass(n));
+}
+
+// allocate a block of at least n bytes, its real size is arenaBlockSize(n)
+void *arenaAlloc(struct arena *a, size_t n) {
+  if (n > ARENA_MAX_CLASS) {
+    struct arenaBig *big = malloc(sizeof(struct arenaBig) + n);
+    if (big == NULL) die("malloc");
+    big->size = n;
+    big->prev = NULL;
+    big->next = a->big;
+    if (a->big) a->big->prev = big;
+    a->big = big;
+    a->used += n;
+    a->bigBytes += sizeof(struct arenaBig) + n;
+    return big + 1;
+  }
+  int c = arenaClass(n);
+  size_t size = arenaClassSize(c);
+  a->used += size;
+  void *p = a->free[c];
+  if (p) {
+    a->free[c] = *(void **)p;
+    a->freeBytes -= size;
+    return p;
+  }
+  if ((size_t)(a->end - a->next) < size) {
+    // whatever is left at the end of the current chunk is given up
+    struct arenaChunk *chunk = malloc(KILO_ARENA_CHUNK);
+    if (chunk == NULL) die("malloc");
+    chunk->next = a->chunks;
+    a->chunks = chunk;
+    a->nchunks++;
+    a->next = (char *)(chunk + 1);
+    a->end = (char *)chunk + KILO_ARENA_CHUNK;
+  }
+  p = a->next;
+  a->next += size;
+  return p;
+}
+
+// give back a block, n is the size it was allocated with (or its arenaBlockSize)
+void arenaFree(struct arena *a, void *p, size_t n) {
+  if (p == NULL) return;
+  if (n > ARENA_MAX_CLASS) {
+    struct arenaBig *big = (struct arenaBig *)p - 1;
+    if (big->prev) big->prev->next = big->next;
+    else a->big = big->next;
+    if (big->next) big->next->prev = big->prev;
+    a->used -= big->size;
+    a->bigBytes -= sizeof(struct arenaBig) + big->size;
+    free(big);
+    return;
+  }
+  int c = arenaClass(n);
+  *(void **)p = a->free[c];
+  a->free[c] = p;
+  a->used -= arenaClassSize(c);
+  a->freeBytes += arenaClassSize(c);
+}
+
+// resize a block of *cap bytes to hold at least n, keeping its contents, *cap gets the new size
+// growing inside the block's size class costs nothing
+void *arenaRealloc(struct arena *a, void *p, int *cap, size_t n) {
+  if (p && n <= (size_t)*cap) return p;
+  size_t size = arenaBlockSize(n);
+  // a big block that keeps growing (typing at the end of a long row) grows by half, not byte by byte
+  if (p && size > ARENA_MAX_CLASS && size < (size_t)*cap + *cap / 2) size = *cap + *cap / 2;
+  void *q = arenaAlloc(a, size);
+  if (p) {
+    memcpy(q, p, *cap);
+    arenaFree(a, p, *cap);
+  }
+  *cap = size;
+  return q;
+}
+
+// bytes the arena took from malloc
+size_t arenaReserved(struct arena *a) {
+  return (size_t)a->nchunks * KILO_ARENA_CHUNK + a->bigBytes;
+}
+
+// free every block at once
+void arenaReset(struct arena *a) {
+  while (a->chunks) {
+    struct arenaChunk *next = a->chunks->next;
+    free(a->chunks);
+    a->chunks = next;
+  }
+  while (a->big) {
+    struct arenaBig *next = a->big->next;
+    free(a->big);
+    a->big = next;
+  }
+  memset(a, 0, sizeof(*a));
+}
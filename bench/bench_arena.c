@@ -0,0 +1,97 @@
+#include "kilo.h"
+#include <sys/wait.h>
+
+/*
+bench_arena: memory and time to build N rows with malloc'd text against the row text arena.
+The malloc run does what editorInsertRow and editorUpdateRow used to do, one malloc for chars
+and one for render per row, the arena run goes through editorInsertRow as it is now
+(which leaves the render to the first time the row is drawn).
+Every run happens in a child process, so the resident size it reports starts from the same point.
+usage: bench_arena [rows]   (default 5000000)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// resident set size in KB
+static long rss() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f == NULL) return 0;
+  if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(f);
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// lines of varying length, like source code or a log
+static int line(char *buf, long i) {
+  unsigned int x = i * 2654435761u;
+  int len = 8 + x % 72;
+  for (int j = 0; j < len; j++) buf[j] = 'a' + (x >> (j % 24)) % 26;
+  return len;
+}
+
+static void runMalloc(long n) {
+  char buf[128];
+  long before = rss();
+  double t0 = now();
+  for (long i = 0; i < n; i++) {
+    int len = line(buf, i);
+    erow *row = rsInsert(&E.rows, i);
+    row->size = len;
+    row->chars = malloc(len + 1);
+    memcpy(row->chars, buf, len);
+    row->chars[len] = '\0';
+    row->render = malloc(len + 1);
+    memcpy(row->render, buf, len + 1);
+    row->rsize = len;
+    row->flags = 0;
+    row->cap = 0;
+    row->ext = NULL;
+  }
+  double t1 = now();
+  long after = rss();
+  for (long i = 0; i < n; i++) {
+    erow *row = rsAt(&E.rows, i);
+    free(row->chars);
+    free(row->render);
+  }
+  rsFree(&E.rows);
+  double t2 = now();
+  printf("%-8s %12.3f %12.3f %12ld\n", "malloc", t1 - t0, t2 - t1, (after - before) / 1024);
+}
+
+static void runArena(long n) {
+  char buf[128];
+  long before = rss();
+  double t0 = now();
+  for (long i = 0; i < n; i++) {
+    int len = line(buf, i);
+    editorInsertRow(i, buf, len);
+  }
+  double t1 = now();
+  long after = rss();
+  editorCloseFile();
+  double t2 = now();
+  printf("%-8s %12.3f %12.3f %12ld\n", "arena", t1 - t0, t2 - t1, (after - before) / 1024);
+}
+
+int main(int argc, char *argv[]) {
+  long n = argc >= 2 ? atol(argv[1]) : 5000000;
+  rsInit(&E.rows);
+  printf("%ld rows\n%-8s %12s %12s %12s\n", n, "alloc", "fill (s)", "close (s)", "rss (MB)");
+  void (*runs[])(long) = {runMalloc, runArena};
+  for (int r = 0; r < 2; r++) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      runs[r](n);
+      exit(0);
+    }
+    waitpid(pid, NULL, 0);
+  }
+  return 0;
+}
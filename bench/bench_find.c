@@ -0,0 +1,114 @@
+#include "kilo.h"
+
+/*
+bench_find: counting every match of a query over a big file, the work the search prompt does for a new query.
+The memmem run is the loop editorFindCallback used to run, memmem over the chars of each row.
+The kernel runs call the text search kernels on each row, then the best kernel in the
+case-insensitive and whole-word modes. The prompt runs are the search prompt itself, which searches
+rows that are still one block in the mapped file with one call per chunk of rows, on 1, 2, 4 ... worker
+threads. For those "blocked" is how long the key that started the search held up the prompt.
+usage: bench_find [megabytes] [query] [max_threads]   (default 1024 MB, "request 4242", one per online cpu)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t bytes, long matches, double secs) {
+  printf("%-14s %10ld matches %8.3f s %8.2f GB/s\n", name, matches, secs, bytes / secs / 1e9);
+}
+
+static void runMemmem(const char *query, size_t bytes) {
+  size_t qlen = strlen(query);
+  long matches = 0;
+  double t0 = now();
+  for (int i = 0; i < E.numrows; i++) {
+    erow *row = rsAt(&E.rows, i);
+    char *p = row->chars, *end = row->chars + row->size, *m;
+    while ((m = memmem(p, end - p, query, qlen)) != NULL) {
+      matches++;
+      p = m + 1;
+    }
+  }
+  report("memmem", bytes, matches, now() - t0);
+}
+
+static void runPrompt(const char *query, int threads, size_t bytes) {
+  char name[32];
+  E.threads = threads;
+  snprintf(name, sizeof(name), "prompt %d thr", threads);
+  double t0 = now();
+  editorFindCallback((char *)query, query[strlen(query) - 1]);
+  double t1 = now();
+  int matches = editorFindCount(); // waits for the workers
+  double t2 = now();
+  printf("%-14s %10d matches %8.3f s %8.2f GB/s   blocked %.2f ms\n", name, matches, t2 - t0,
+         bytes / (t2 - t0) / 1e9, (t1 - t0) * 1e3);
+  editorFindCallback((char *)query, '\x1b');
+}
+
+static void runKernel(const char *name, textSearchFn fn, const char *query, int flags, size_t bytes) {
+  size_t qlen = strlen(query);
+  long matches = 0;
+  double t0 = now();
+  for (int i = 0; i < E.numrows; i++) {
+    erow *row = rsAt(&E.rows, i);
+    long m = -1;
+    while ((size_t)row->size >= qlen && (m = fn(row->chars, row->size, m + 1, query, qlen, flags)) != -1) matches++;
+  }
+  report(name, bytes, matches, now() - t0);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 1024) << 20;
+  const char *query = argc >= 3 ? argv[2] : "request 4242";
+  int maxthreads = argc >= 4 ? atoi(argv[3]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxthreads > KILO_MAX_THREADS) maxthreads = KILO_MAX_THREADS;
+
+  // a log-like corpus
+  char path[] = "/tmp/bench_findXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = (x >> 8) % 4 == 0
+      ? snprintf(line, sizeof(line), "%u\t%u\tGET\t/api/v1/items\t200\n", x % 100000, (x >> 3) % 997)
+      : snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO Request %u served\n", (x >> 4) % 60, x % 100000);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  E.threads = 1;
+  rsInit(&E.rows);
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+  printf("%zu MB, %d rows, query \"%s\"\n", written >> 20, E.numrows, query);
+  // the first pass faults in the pages, every run after it reads them from memory
+  runMemmem(query, written);
+  runMemmem(query, written);
+  runKernel("scalar", textSearchScalar, query, 0, written);
+#if defined(__x86_64__) || defined(__i386__)
+  runKernel("sse2", textSearchSSE2, query, 0, written);
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) runKernel("avx2", textSearchAVX2, query, 0, written);
+#endif
+  for (int t = 1; t <= maxthreads; t *= 2) {
+    runPrompt(query, t, written);
+    if (t < maxthreads && t * 2 > maxthreads) t = maxthreads / 2;
+  }
+  runKernel("textSearch icase", textSearch, query, SEARCH_ICASE, written);
+  runKernel("textSearch word", textSearch, query, SEARCH_WORD, written);
+  printf("the search prompt uses: %s\n", textSearchName());
+  editorCloseFile();
+  unlink(path);
+  return 0;
+}
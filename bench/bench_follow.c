@@ -0,0 +1,220 @@
+#include "kilo.h"
+
+/*
+bench_follow: --follow on a log that a writer thread appends to.
+The main thread does what the editor loop does: it takes the new lines (editorFollowPoll()) until a frame is due,
+then draws the last screen of rows, 60 frames a second. The flood run writes N lines as fast as it can, some of
+them cut in two writes; the steady run writes 100K lines a second for a few seconds. Both give the lines per
+second that got into the buffer, the slowest poll, and how many lines the buffer was behind the file at most
+when a frame was drawn. The text is checked against the file after each run, and that the cursor followed.
+Then the log is truncated and written again, then rotated (renamed away, a few more lines into the old one, a
+new file made), and the buffer is checked against the file after each.
+What following replaces, opening the grown file again, is timed for comparison.
+usage: bench_follow [lines] [megabytes]   (default 2000000 lines, a 64 MB file to start with)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// rsEach visitor: FNV-1a of the text of the rows, a newline after each
+static int hashRows(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  uint64_t *h = arg;
+  for (int i = 0; i < n; i++) {
+    erow *row = &rows[i];
+    int gap = row->ext ? row->ext->gapStart : row->size;
+    int gapLen = row->ext ? row->ext->gapLen : 0;
+    for (int k = 0; k < row->size; k++) *h = (*h ^ (unsigned char)row->chars[k < gap ? k : k + gapLen]) * 1099511628211u;
+    *h = (*h ^ '\n') * 1099511628211u;
+  }
+  return 1;
+}
+
+static uint64_t hashText() {
+  uint64_t h = 14695981039346656037u;
+  rsEach(&E.rows, 0, hashRows, &h);
+  return h;
+}
+
+static uint64_t hashFile(const char *path) {
+  uint64_t h = 14695981039346656037u;
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return 0;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)buf[i]) * 1099511628211u;
+  fclose(f);
+  return h;
+}
+
+static int logLine(char *line, int size, long i) {
+  unsigned int x = i * 2654435761u;
+  return snprintf(line, size, "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", x % 60, x % 100000, x % 97);
+}
+
+static struct {
+  int fd;
+  long lines; // lines to write
+  long rate; // lines a second, 0 for as fast as it goes
+  long written; // lines written so far
+} writer;
+
+static void *writeLog(void *arg) {
+  (void)arg;
+  char buf[64 * 128];
+  double t0 = now();
+  for (long i = 0; i < writer.lines;) {
+    // 64 lines a write, every 7th write cut in the middle of a line
+    int len = 0;
+    long first = i;
+    for (int k = 0; k < 64 && i < writer.lines; k++, i++) len += logLine(buf + len, sizeof(buf) - len, i);
+    int cut = first % 7 == 0 ? len / 2 + 1 : len;
+    if (write(writer.fd, buf, cut) != cut || (cut < len && write(writer.fd, buf + cut, len - cut) != len - cut))
+      die("write");
+    __atomic_store_n(&writer.written, i, __ATOMIC_RELEASE);
+    if (writer.rate) {
+      double due = t0 + (double)i / writer.rate;
+      while (now() < due) usleep(1000);
+    }
+  }
+  return NULL;
+}
+
+// draw the last screen of rows, like a frame of the editor following the end of the file
+static void drawFrame() {
+  int top = E.numrows > E.screenrows ? E.numrows - E.screenrows : 0;
+  for (int y = top; y < E.numrows; y++) editorRowRender(rsAt(&E.rows, y));
+}
+
+// run the writer for lines lines at rate lines a second, and the editor loop until the buffer has them all
+static void run(const char *name, const char *path, long lines, long rate) {
+  writer.fd = open(path, O_WRONLY | O_APPEND);
+  if (writer.fd == -1) die("open");
+  writer.lines = lines;
+  writer.rate = rate;
+  writer.written = 0;
+  long start = editorFollowStats(NULL), polls0;
+  editorFollowStats(&polls0);
+  pthread_t tid;
+  if (pthread_create(&tid, NULL, writeLog, NULL) != 0) die("pthread_create");
+  double t0 = now(), worst = 0;
+  long behind = 0, frames = 0;
+  while (editorFollowStats(NULL) - start < lines) {
+    double due = now() + 1.0 / KILO_MAX_FPS;
+    while (now() < due) {
+      long before = editorFollowStats(NULL);
+      double p0 = now();
+      editorFollowPoll();
+      double p = now() - p0;
+      if (p > worst) worst = p;
+      if (editorFollowStats(NULL) == before) usleep(1000);
+    }
+    drawFrame();
+    frames++;
+    long lag = __atomic_load_n(&writer.written, __ATOMIC_ACQUIRE) - (editorFollowStats(NULL) - start);
+    if (lag > behind) behind = lag;
+  }
+  double t = now() - t0;
+  pthread_join(tid, NULL);
+  close(writer.fd);
+  long polls;
+  editorFollowStats(&polls);
+  int same = hashText() == hashFile(path);
+  printf("%-7s %8ld lines in %6.0f ms, %8.0f lines/s, %5ld reads, slowest poll %5.2f ms, at most %6ld lines behind in "
+         "%ld frames, %s, %s\n", name, lines, t * 1e3, lines / t, polls - polls0, worst * 1e3, behind, frames,
+         same ? "text matches" : "TEXT DIFFERS", E.cy == E.numrows ? "cursor at the end" : "CURSOR LEFT BEHIND");
+}
+
+// poll until the buffer has rows rows, or a second went by
+static void settle(int rows) {
+  double t0 = now();
+  while (E.numrows != rows && now() - t0 < 1) {
+    editorFollowPoll();
+    usleep(1000);
+  }
+  editorFollowPoll();
+}
+
+static void writeLines(const char *path, int flags, long from, long n) {
+  int fd = open(path, O_WRONLY | O_CREAT | flags, 0644);
+  if (fd == -1) die("open");
+  char line[256];
+  for (long i = from; i < from + n; i++) {
+    int len = logLine(line, sizeof(line), i);
+    if (write(fd, line, len) != len) die("write");
+  }
+  close(fd);
+}
+
+int main(int argc, char *argv[]) {
+  long lines = argc >= 2 ? atol(argv[1]) : 2000000;
+  size_t len = (size_t)(argc >= 3 ? atol(argv[2]) : 64) << 20;
+
+  char path[] = "/tmp/bench_followXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  close(fd);
+  long initial = 0;
+  char line[256];
+  FILE *out = fopen(path, "w");
+  for (size_t written = 0; written < len; initial++) written += fwrite(line, 1, logLine(line, sizeof(line), initial), out);
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  E.threads = 1;
+  rsInit(&E.rows);
+  editorOpen(path);
+  double t0 = now();
+  editorFollowOpen();
+  settle(initial);
+  printf("%zu MB, %d rows, indexed and at the end in %.0f ms\n", len >> 20, E.numrows, (now() - t0) * 1e3);
+
+  run("flood", path, lines, 0);
+  run("steady", path, 300000, 100000);
+
+  // what following saves: opening the grown file again to see its new lines
+  struct stat st;
+  stat(path, &st);
+  int rows = E.numrows;
+  char *name = strdup(path);
+  t0 = now();
+  editorCloseFile();
+  editorOpen(name);
+  editorIndexTo(INT_MAX);
+  double reopen = now() - t0;
+  printf("reopen  %lld MB, %d rows in %.0f ms, %s\n", (long long)st.st_size >> 20, E.numrows, reopen * 1e3,
+         rows == E.numrows ? "same rows" : "ROWS DIFFER");
+  editorFollowSaved(st.st_size);
+  E.cy = E.numrows;
+
+  // copytruncate: the file is cut to nothing and written again
+  if (truncate(path, 0) == -1) die("truncate");
+  writeLines(path, O_APPEND, 0, 1000);
+  settle(1000);
+  printf("truncate %d rows, %s   %s\n", E.numrows, hashText() == hashFile(path) ? "text matches" : "TEXT DIFFERS",
+         E.statusmsg);
+
+  // rotation: renamed away, the writer still gets some lines into the old file, then a new one is made
+  char old[64];
+  snprintf(old, sizeof(old), "%s.1", path);
+  if (rename(path, old) == -1) die("rename");
+  writeLines(old, O_APPEND, 1000, 10);
+  settle(1010);
+  int before = E.numrows;
+  uint64_t oldText = hashText();
+  writeLines(path, O_EXCL, 5000, 500);
+  settle(500);
+  printf("rotate  %d rows of the old file, %s, then %d rows, %s   %s\n", before,
+         oldText == hashFile(old) ? "text matches" : "TEXT DIFFERS", E.numrows,
+         hashText() == hashFile(path) ? "text matches" : "TEXT DIFFERS", E.statusmsg);
+  editorCloseFile();
+  unlink(old);
+  unlink(path);
+  free(name);
+  return 0;
+}
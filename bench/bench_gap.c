@@ -0,0 +1,49 @@
+#include "kilo.h"
+
+/*
+bench_gap: typing into the middle of one very long row, like a minified bundle or a base64 blob.
+Types 10K characters at the middle of a 50 MB line, each key followed by the scroll and row drawing
+a frame does. The gap run is the editor as it is, the flat run closes the gap after every key,
+which moves the rest of the row on every key the way editorRowInsertChar used to.
+usage: bench_gap [megabytes] [keys]   (default 50 MB, 10000 keys)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(int size, int keys, int flat) {
+  char *line = malloc(size);
+  for (int i = 0; i < size; i++) line[i] = i % 61 == 0 ? '\t' : 'a' + i % 26;
+  editorInsertRow(0, line, size);
+  free(line);
+  E.cy = 0;
+  E.cx = size / 2;
+  double t0 = now();
+  for (int i = 0; i < keys; i++) {
+    editorInsertChar('x');
+    if (flat) editorRowCloseGap(rsAt(&E.rows, 0));
+    editorScroll();
+    for (int y = 0; y < E.screenrows; y++) abReset(&E.back[y]);
+    editorDrawRows(E.back);
+  }
+  double t1 = now();
+  editorCloseFile();
+  return (t1 - t0) * 1e6 / keys;
+}
+
+int main(int argc, char *argv[]) {
+  int size = (argc >= 2 ? atoi(argv[1]) : 50) << 20;
+  int keys = argc >= 3 ? atoi(argv[2]) : 10000;
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  editorResizeScreen(E.screenrows + 2);
+  printf("%d MB line, %d keys in the middle\n", size >> 20, keys);
+  printf("%-6s %12s\n", "run", "us/key");
+  printf("%-6s %12.2f\n", "gap", run(size, keys, 0));
+  printf("%-6s %12.2f\n", "flat", run(size, keys, 1));
+  return 0;
+}
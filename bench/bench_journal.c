@@ -0,0 +1,160 @@
+#include "kilo.h"
+
+/*
+bench_journal: what the edit journal costs per key, and how long recovery takes.
+The typing run types N keys into a generated file, anywhere in it, a newline every 60 keys and a backspace
+every 10, once without a journal and once with one, and gives the time per key of both and the slowest key.
+Then a paste, a delete, an undo and redo of them and a replace of a few spans go in too, so every kind of
+record is in the journal. The journal is then left behind as a crash would leave it, with a record cut short
+at the end, the file is opened again with recovery, and the text it gets back is checked against the text
+before the crash.
+usage: bench_journal [keys] [megabytes]   (default 1000000 keys, 64 MB)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// rsEach visitor: FNV-1a of the text of the rows, newlines included
+static int hashRows(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  uint64_t *h = arg;
+  for (int i = 0; i < n; i++) {
+    erow *row = &rows[i];
+    int gap = row->ext ? row->ext->gapStart : row->size;
+    int gapLen = row->ext ? row->ext->gapLen : 0;
+    for (int k = 0; k < row->size; k++) *h = (*h ^ (unsigned char)row->chars[k < gap ? k : k + gapLen]) * 1099511628211u;
+    *h = (*h ^ '\n') * 1099511628211u;
+  }
+  return 1;
+}
+
+static uint64_t hashText() {
+  uint64_t h = 14695981039346656037u;
+  editorIndexTo(INT_MAX);
+  rsEach(&E.rows, 0, hashRows, &h);
+  return h;
+}
+
+static void openFile(char *path) {
+  rsInit(&E.rows);
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+}
+
+// returns the seconds the keys took, the slowest one in *worst
+static double typing(int keys, double *worst) {
+  unsigned int x = 7;
+  *worst = 0;
+  double t0 = now();
+  for (int i = 0; i < keys; i++) {
+    // a new place every 60 keys, like someone moving around the file
+    if (i % 60 == 0) {
+      x = x * 1103515245u + 12345u;
+      E.cy = (x >> 4) % E.numrows;
+      E.cx = 0;
+    }
+    double k0 = now();
+    if (i % 60 == 59) editorInsertNewline();
+    else if (i % 10 == 9) editorDelChar();
+    else editorInsertChar('a' + i % 26);
+    double k = now() - k0;
+    if (k > *worst) *worst = k;
+  }
+  return now() - t0;
+}
+
+int main(int argc, char *argv[]) {
+  int keys = argc >= 2 ? atoi(argv[1]) : 1000000;
+  size_t len = (size_t)(argc >= 3 ? atol(argv[2]) : 64) << 20;
+
+  char path[] = "/tmp/bench_journalXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", (x >> 4) % 60, x % 100000, x % 97);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  openFile(path);
+  printf("%zu MB, %d rows, %d keys\n", written >> 20, E.numrows, keys);
+  double worst;
+  double plain = typing(keys, &worst);
+  printf("no journal:   %.3f us/key, slowest %.3f ms\n", plain / keys * 1e6, worst * 1e3);
+  editorCloseFile();
+
+  openFile(path);
+  editorJournalOpen(0);
+  double journaled = typing(keys, &worst);
+  long records, syncs;
+  size_t bytes = editorJournalStats(&records, &syncs);
+  printf("journal:      %.3f us/key, slowest %.3f ms, %.3f us/key over no journal\n", journaled / keys * 1e6,
+         worst * 1e3, (journaled - plain) / keys * 1e6);
+  printf("              %ld records, %zu bytes, %ld group commits, %.0f records per commit\n", records, bytes,
+         syncs, syncs ? (double)records / syncs : 0.0);
+
+  // every other kind of record
+  E.cy = E.numrows / 3;
+  E.cx = 0;
+  editorInsertText("pasted line one\npasted line two\npasted", 38);
+  editorDeleteText(E.numrows / 2, 3, 200);
+  editorUndo();
+  editorUndo();
+  editorRedo();
+  struct replaceSpan spans[3] = {{10, 0, 4, "YEAR", 4}, {10, 5, 2, "MM", 2}, {20, 0, 10, "", 0}};
+  editorReplaceSpans(spans, 3);
+  E.cy = E.numrows;
+  E.cx = 0;
+  editorInsertNewline();
+  editorInsertChar('z');
+  editorUndo();
+  uint64_t before = hashText();
+  int rows = E.numrows;
+
+  // crash: the journal stays, and the last write was cut short
+  editorJournalSync();
+  editorJournalClose(0);
+  char jpath[64];
+  snprintf(jpath, sizeof(jpath), "/tmp/.%s.kswp", path + 5);
+  int jfd = open(jpath, O_WRONLY | O_APPEND);
+  if (jfd == -1) die("open journal");
+  if (write(jfd, "\x15\0\0\0torn", 8) != 8) die("write");
+  close(jfd);
+  struct stat st;
+  stat(jpath, &st);
+  editorCloseFile();
+
+  double t0 = now();
+  openFile(path);
+  editorJournalOpen(1);
+  double t = now() - t0;
+  uint64_t after = hashText();
+  printf("recovery:     %.0f ms for %lld bytes of journal, %d rows, %s   %s\n", t * 1e3, (long long)st.st_size,
+         E.numrows, before == after && rows == E.numrows ? "text matches" : "TEXT DIFFERS", E.statusmsg);
+
+  // what a key costs the journal alone, the record copied into the buffer
+  editorCloseFile();
+  unlink(jpath);
+  openFile(path);
+  editorJournalOpen(0);
+  editorInsertChar('a'); // makes the journal
+  int n = 1000000;
+  t0 = now();
+  for (int i = 0; i < n; i++) editorJournal(JOURNAL_CHAR, 0, 1, "a", 1);
+  t = now() - t0;
+  printf("append:       %.1f ns per record\n", t / n * 1e9);
+  editorCloseFile();
+  unlink(path);
+  return before == after ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#include "kilo.h"
+
+/*
+bench_lineindex: newline scanning throughput for file load.
+Compares the getline loop editorOpen used to run (getline plus trimming the line ending)
+with the scalar, SSE2 and AVX2 line index kernels over the same file.
+usage: bench_lineindex [megabytes]   (default 256)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t bytes, size_t lines, double secs) {
+  printf("%-10s %10zu lines %8.3f s %8.2f GB/s\n", name, lines, secs, bytes / secs / 1e9);
+}
+
+// best of three passes, the first one also pays for faulting in the pages
+static void runKernel(const char *name, lineIndexFn fn, const char *buf, size_t len) {
+  size_t offs[KILO_INDEX_BATCH];
+  size_t lines = 0;
+  double best = 1e9;
+  for (int pass = 0; pass < 3; pass++) {
+    size_t pos = 0;
+    lines = 0;
+    double t0 = now();
+    while (pos < len) {
+      size_t n = fn(buf + pos, len - pos, offs, KILO_INDEX_BATCH);
+      if (n == 0) break;
+      lines += n;
+      pos += offs[n - 1] + 1;
+    }
+    if (now() - t0 < best) best = now() - t0;
+  }
+  report(name, len, lines, best);
+}
+
+int main(int argc, char *argv[]) {
+  size_t mb = argc >= 2 ? (size_t)atol(argv[1]) : 256;
+  size_t len = mb << 20;
+
+  // a log-like corpus with lines of varying length
+  char path[] = "/tmp/bench_lineindexXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  unlink(path);
+  char line[256];
+  size_t written = 0;
+  unsigned int x = 1;
+  FILE *out = fdopen(dup(fd), "w");
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = snprintf(line, sizeof(line), "2024-01-01 12:%02u:%02u INFO worker=%u request served%*s\n",
+      (x >> 8) % 60, (x >> 16) % 60, x % 97, (int)((x >> 4) % 120), "");
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  // the old editorOpen loop
+  FILE *fp = fdopen(dup(fd), "r");
+  rewind(fp);
+  char *l = NULL;
+  size_t linecap = 0, lines = 0;
+  ssize_t linelen;
+  double t0 = now();
+  while ((linelen = getline(&l, &linecap, fp)) != -1) {
+    while (linelen > 0 && (l[linelen - 1] == '\n' || l[linelen - 1] == '\r'))
+      linelen--;
+    lines++;
+  }
+  report("getline", written, lines, now() - t0);
+  free(l);
+  fclose(fp);
+
+  char *buf = mmap(NULL, written, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+  if (buf == MAP_FAILED) die("mmap");
+  runKernel("scalar", lineIndexScalar, buf, written);
+#if defined(__x86_64__) || defined(__i386__)
+  runKernel("sse2", lineIndexSSE2, buf, written);
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) runKernel("avx2", lineIndexAVX2, buf, written);
+#endif
+  printf("editorOpen uses: %s\n", lineIndexName());
+  munmap(buf, written);
+  close(fd);
+  return 0;
+}
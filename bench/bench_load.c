@@ -0,0 +1,57 @@
+#include "kilo.h"
+
+/*
+bench_load: time to index a whole file with 1, 2, 4 ... worker threads.
+Each run opens the file through editorOpen, then indexes every row the way a search or a save does,
+and the speedup is reported against the single thread run.
+usage: bench_load [megabytes] [max_threads]   (default 512 MB, one thread per online cpu)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 512) << 20;
+  int maxthreads = argc >= 3 ? atoi(argv[2]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (maxthreads > KILO_MAX_THREADS) maxthreads = KILO_MAX_THREADS;
+
+  // a capture-like file, every fourth line is tab separated
+  char path[] = "/tmp/bench_loadXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = (x >> 8) % 4 == 0
+      ? snprintf(line, sizeof(line), "%u\t%u\tGET\t/api/v1/items\t200\n", x % 100000, (x >> 3) % 997)
+      : snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO request %u served\n", (x >> 4) % 60, x);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  double base = 0;
+  printf("%8s %10s %10s %10s\n", "threads", "rows", "time (s)", "speedup");
+  for (int t = 1; t <= maxthreads; t *= 2) {
+    E.threads = t;
+    double t0 = now();
+    editorOpen(path);
+    editorIndexTo(INT_MAX);
+    double secs = now() - t0;
+    if (t == 1) base = secs;
+    printf("%8d %10d %10.3f %10.2f\n", t, E.numrows, secs, base / secs);
+    editorCloseFile();
+    if (t < maxthreads && t * 2 > maxthreads) t = maxthreads / 2;
+  }
+  unlink(path);
+  return 0;
+}
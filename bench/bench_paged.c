@@ -0,0 +1,115 @@
+#include "kilo.h"
+
+/*
+bench_paged: a file opened with --max-resident against one opened as usual.
+Both index the whole file, jump to random rows and draw a screen of rows there, type into some of them and save.
+The paged run keeps its pages within the budget (the trim runs between "frames" like in the editor), the usual
+one has a row for every line. Gives the time of each step and the resident memory of the process, and checks
+that both saves wrote the same file.
+usage: bench_paged [megabytes] [budget MB] [jumps]   (default 1024 MB, 64 MB, 2000 jumps)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// resident memory of the process in MB, the mapped file pages it touched included
+static long rssMB() {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+  }
+  return resident * sysconf(_SC_PAGESIZE) >> 20;
+}
+
+static uint64_t hashFile(const char *path) {
+  uint64_t h = 14695981039346656037u;
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return 0;
+  char buf[1 << 16];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    for (size_t i = 0; i < n; i++) h = (h ^ (unsigned char)buf[i]) * 1099511628211u;
+  fclose(f);
+  return h;
+}
+
+static uint64_t run(const char *name, char *path, size_t budget, int jumps) {
+  E.maxResident = budget;
+  rsInit(&E.rows);
+  double t0 = now();
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+  double indexed = now() - t0;
+  printf("%-6s index   %8.0f ms, %d rows, rss %ld MB\n", name, indexed * 1e3, E.numrows, rssMB());
+
+  unsigned int x = 3;
+  t0 = now();
+  for (int i = 0; i < jumps; i++) {
+    x = x * 1103515245u + 12345u;
+    int top = (x >> 4) % E.numrows;
+    for (int y = 0; y < E.screenrows && top + y < E.numrows; y++) editorRowRender(rsAt(&E.rows, top + y));
+    editorPageTrim();
+  }
+  double jumped = now() - t0;
+  printf("%-6s jumps   %8.3f ms each, rss %ld MB, pages in %zu MB\n", name, jumped / jumps * 1e3, rssMB(),
+         E.rows.resident >> 20);
+
+  // one key into every 50000th row, then a save, which has to write the whole file
+  x = 5;
+  for (int i = 0; i < E.numrows; i += 50000) {
+    E.cy = i;
+    E.cx = 0;
+    editorInsertChar('K');
+  }
+  editorPageTrim();
+  t0 = now();
+  editorSave();
+  editorSaveWait();
+  double saved = now() - t0;
+  printf("%-6s save    %8.0f ms, rss %ld MB   %s\n", name, saved * 1e3, rssMB(), E.statusmsg);
+  editorCloseFile();
+  return hashFile(path);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 1024) << 20;
+  size_t budget = (size_t)(argc >= 3 ? atol(argv[2]) : 64) << 20;
+  int jumps = argc >= 4 ? atoi(argv[3]) : 2000;
+
+  char paged[] = "/tmp/bench_pagedXXXXXX";
+  int fd = mkstemp(paged);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", (x >> 4) % 60, x % 100000, x % 97);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+  char usual[] = "/tmp/bench_pagedXXXXXX";
+  fd = mkstemp(usual);
+  if (fd == -1) die("mkstemp");
+  close(fd);
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "cp %s %s", paged, usual);
+  if (system(cmd) != 0) die("cp");
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  printf("%zu MB file, budget %zu MB, %d jumps of a screen of rows\n", written >> 20, budget >> 20, jumps);
+  uint64_t a = run("paged", paged, budget, jumps);
+  uint64_t b = run("usual", usual, 0, jumps);
+  printf("saved files %s\n", a == b ? "match" : "DIFFER");
+  unlink(paged);
+  unlink(usual);
+  return a == b ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "kilo.h"
+#include <regex.h>
+
+/*
+bench_regex: regex search throughput in MB/s over a log file.
+For each pattern the rows are run through regexFind one at a time, then the search prompt searches the whole
+file the way it does for a new query (the literal prefix, when there is one, searched over blocks of rows first).
+The (ERROR) pattern matches the same as ERROR but hides the prefix, so it shows what the prefilter buys over
+the DFA alone. The 404 pattern never matches, a miss costs a scan of every row.
+libc's regexec over the same rows is the reference.
+usage: bench_regex [megabytes]   (default 256)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, const char *pattern, size_t bytes, long matches, double secs) {
+  printf("%-8s %-26s %10ld matches %10.1f MB/s\n", name, pattern, matches, bytes / secs / 1e6);
+}
+
+static void runRows(const char *pattern, size_t bytes) {
+  const char *err;
+  struct regex *re = regexCompile(pattern, 0, &err);
+  if (re == NULL) die(err);
+  long matches = 0;
+  double t0 = now();
+  for (int i = 0; i < E.numrows; i++) {
+    erow *row = rsAt(&E.rows, i);
+    size_t end;
+    for (long m = regexFind(re, row->chars, row->size, 0, &end); m != -1; m = regexFind(re, row->chars, row->size, end, &end))
+      matches++;
+  }
+  report("rows", pattern, bytes, matches, now() - t0);
+  regexFree(re);
+}
+
+static void runPrompt(const char *pattern, size_t bytes) {
+  double t0 = now();
+  editorFindCallback((char *)pattern, 'x');
+  int matches = editorFindCount(); // waits for the search to finish
+  report("prompt", pattern, bytes, matches, now() - t0);
+  editorFindCallback((char *)pattern, '\x1b');
+}
+
+static void runLibc(const char *pattern, size_t bytes) {
+  regex_t re;
+  if (regcomp(&re, pattern, REG_EXTENDED)) die("regcomp");
+  long matches = 0;
+  char *line = NULL;
+  int cap = 0;
+  double t0 = now();
+  for (int i = 0; i < E.numrows; i++) {
+    erow *row = rsAt(&E.rows, i);
+    // regexec wants a C string, mapped rows are not terminated
+    if (row->size + 1 > cap) {
+      cap = row->size + 1;
+      line = realloc(line, cap);
+    }
+    memcpy(line, row->chars, row->size);
+    line[row->size] = '\0';
+    regmatch_t m;
+    for (int off = 0; off < row->size && regexec(&re, line + off, 1, &m, off ? REG_NOTBOL : 0) == 0;) {
+      matches++;
+      off += m.rm_eo > m.rm_so ? m.rm_eo : m.rm_so + 1;
+    }
+  }
+  report("libc", pattern, bytes, matches, now() - t0);
+  free(line);
+  regfree(&re);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 256) << 20;
+
+  // a log-like corpus, one line in 50 is an error
+  char path[] = "/tmp/bench_regexXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = (x >> 8) % 50 == 0
+      ? snprintf(line, sizeof(line), "2024-01-01 12:00:%02u ERROR upstream call failed timeout=%ums\n", (x >> 4) % 60, x % 5000)
+      : snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", (x >> 4) % 60, x % 100000, x % 97);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  E.threads = 1;
+  rsInit(&E.rows);
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+  printf("%zu MB, %d rows\n", written >> 20, E.numrows);
+  editorFindCallback("", CTRL_KEY('r')); // regex mode for the prompt runs
+  const char *patterns[] = {"ERROR.*timeout=[0-9]+", "(ERROR).*timeout=[0-9]+", "items/[0-9]+ 404", "[0-9]{4}ms$"};
+  for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+    runRows(patterns[i], written);
+    runPrompt(patterns[i], written);
+    runLibc(patterns[i], written);
+  }
+  editorCloseFile();
+  unlink(path);
+  return 0;
+}
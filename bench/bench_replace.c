@@ -0,0 +1,62 @@
+#include "kilo.h"
+
+/*
+bench_replace: replace-all from the search prompt over a log file.
+Searches a pattern with about a match in every few lines, replaces every match through editorReplaceAll,
+then times the undo and the redo of the replace, each one a single record that rebuilds the rows once.
+usage: bench_replace [megabytes]   (default 1024)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 1024) << 20;
+
+  // a log-like corpus, one line in 16 is an error
+  char path[] = "/tmp/bench_replaceXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = (x >> 8) % 16 == 0
+      ? snprintf(line, sizeof(line), "2024-01-01 12:00:%02u ERROR upstream call failed timeout=%ums\n", (x >> 4) % 60, x % 5000)
+      : snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", (x >> 4) % 60, x % 100000, x % 97);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+  printf("%zu MB, %d rows\n", written >> 20, E.numrows);
+
+  double t0 = now();
+  editorFindCallback("ERROR", 'R');
+  int found = editorFindCount();
+  double t1 = now();
+  int replaced = editorReplaceAll("WARNING", 7);
+  double t2 = now();
+  editorFindCallback("ERROR", '\x1b');
+  printf("%-8s %10d matches %10.1f ms\n", "search", found, (t1 - t0) * 1e3);
+  printf("%-8s %10d matches %10.1f ms\n", "replace", replaced, (t2 - t1) * 1e3);
+  t0 = now();
+  editorUndo();
+  printf("%-8s %21s %10.1f ms\n", "undo", "", (now() - t0) * 1e3);
+  t0 = now();
+  editorRedo();
+  printf("%-8s %21s %10.1f ms\n", "redo", "", (now() - t0) * 1e3);
+  editorCloseFile();
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include "kilo.h"
+
+/*
+bench_rowstore: per-edit latency of Enter and Backspace near the top of the file.
+Fills the editor with N rows through editorInsertRow, then times inserting and deleting
+row 1 the same way editorInsertNewline and editorDelChar do. With the row store the
+cost per edit should stay flat as N grows from 1K to 10M lines.
+usage: bench_rowstore [max_rows]   (default 1000000)
+*/
+
+#define EDITS 100000
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void freeAllRows() {
+  for (int j = 0; j < E.numrows; j++) editorFreeRow(rsAt(&E.rows, j));
+  rsFree(&E.rows);
+  E.numrows = 0;
+}
+
+int main(int argc, char *argv[]) {
+  long max = argc >= 2 ? atol(argv[1]) : 1000000;
+  const char *line = "2024-01-01 12:00:00 INFO request served in 12ms";
+  rsInit(&E.rows);
+  printf("%10s %12s %14s %14s\n", "rows", "fill (s)", "edit (ns/op)", "lookup (ns/op)");
+  for (long n = 1000; n <= max; n *= 10) {
+    double t0 = now();
+    while (E.numrows < n) editorInsertRow(E.numrows, (char *)line, strlen(line));
+    double t1 = now();
+
+    for (int i = 0; i < EDITS; i++) {
+      editorInsertRow(1, "", 0);
+      editorDelRow(1);
+    }
+    double t2 = now();
+
+    // random access lookups defeat the finger cache and measure the tree walk
+    unsigned int x = 12345;
+    long sum = 0;
+    for (int i = 0; i < EDITS; i++) {
+      x = x * 1103515245u + 12345u;
+      sum += rsAt(&E.rows, x % n)->size;
+    }
+    double t3 = now();
+
+    printf("%10ld %12.3f %14.1f %14.1f\n", n, t1 - t0,
+      (t2 - t1) * 1e9 / (2 * EDITS), (t3 - t2) * 1e9 / EDITS + (sum == 0));
+    freeAllRows();
+  }
+  return 0;
+}
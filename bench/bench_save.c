@@ -0,0 +1,115 @@
+#include "kilo.h"
+
+/*
+bench_save: saving a big file in MB/s.
+Opens a generated file and saves it after each of: nothing, one character changed in the middle, lines added near
+the end, one row in 1000 edited, and a long row left with an open gap. The first three only patch what changed,
+the last two stream every row to a temporary file, fsync it and rename it over the target on the background thread.
+blocked is how long editorSave() kept the editor from taking keys, MB/s is the file size over the whole save,
+the status message says how many bytes were written.
+The typing run saves with a full write again and types into the file while it is written, one key per row
+anywhere in the file, and gives the slowest key: the first key into a chunk copies it out of the snapshot.
+usage: bench_save [megabytes]   (default 2048)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t fileSize(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+static void run(const char *name, const char *path) {
+  double t0 = now();
+  editorSave();
+  double blocked = now() - t0;
+  editorSaveWait();
+  double t = now() - t0;
+  size_t size = fileSize(path);
+  printf("%-10s %8zu MB %8.1f ms blocked %8.1f MB/s   %s\n", name, size >> 20, blocked * 1e3, size / t / 1e6, E.statusmsg);
+}
+
+static void runTyping(const char *path) {
+  E.cy = 0;
+  E.cx = 0;
+  editorInsertChar('T'); // one row longer, the rows after it move: a full write
+  double t0 = now();
+  editorSave();
+  double blocked = now() - t0, worst = 0;
+  int keys = 0;
+  unsigned int x = 7;
+  for (; keys < 100000; keys++) {
+    x = x * 1103515245u + 12345u;
+    E.cy = (x >> 4) % E.numrows;
+    E.cx = 0;
+    double k0 = now();
+    editorInsertChar('k');
+    double k = now() - k0;
+    if (k > worst) worst = k;
+  }
+  double typed = now() - t0;
+  editorSaveWait();
+  double t = now() - t0;
+  printf("%-10s %8zu MB %8.1f ms blocked %8.1f MB/s   %d keys in %.0f ms, slowest %.2f ms   %s\n", "typing",
+         fileSize(path) >> 20, blocked * 1e3, fileSize(path) / t / 1e6, keys, typed * 1e3, worst * 1e3, E.statusmsg);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len = (size_t)(argc >= 2 ? atol(argv[1]) : 2048) << 20;
+
+  char path[] = "/tmp/bench_saveXXXXXX";
+  int fd = mkstemp(path);
+  if (fd == -1) die("mkstemp");
+  FILE *out = fdopen(fd, "w");
+  size_t written = 0;
+  unsigned int x = 1;
+  char line[256];
+  while (written < len) {
+    x = x * 1103515245u + 12345u;
+    int n = snprintf(line, sizeof(line), "2024-01-01 12:00:%02u INFO GET /api/v1/items/%u 200 %ums\n", (x >> 4) % 60, x % 100000, x % 97);
+    fwrite(line, 1, n, out);
+    written += n;
+  }
+  fclose(out);
+
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  editorOpen(path);
+  editorIndexTo(INT_MAX);
+  printf("%zu MB, %d rows\n", written >> 20, E.numrows);
+
+  run("untouched", path);
+  E.cy = E.numrows / 2;
+  E.cx = 1;
+  editorDelChar();
+  editorInsertChar('X');
+  run("one char", path);
+  E.cy = E.numrows - 10;
+  editorInsertText("one more line\nand another\n", 26);
+  run("tail", path);
+  for (int i = 0; i < E.numrows; i += 1000) {
+    E.cy = i;
+    E.cx = 0;
+    editorInsertText("edited ", 7);
+  }
+  run("edited", path);
+  // a row long enough to be edited as a gap buffer, typed into the middle
+  E.cy = E.numrows / 2;
+  E.cx = 0;
+  char *big = malloc(KILO_GAP_MIN * 4);
+  memset(big, 'x', KILO_GAP_MIN * 4);
+  editorInsertText(big, KILO_GAP_MIN * 4);
+  free(big);
+  E.cx = KILO_GAP_MIN;
+  editorInsertChar('y');
+  run("gap", path);
+  runTyping(path);
+  editorCloseFile();
+  unlink(path);
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "kilo.h"
+
+/*
+bench_search: typing a query into the search prompt over a big file.
+Builds N rows of words and types a query one key at a time through editorFindCallback.
+The table run is the prompt as it is, each key narrows the previous key's matches down.
+The rescan run resets the search before every key, so each key scans the whole file again.
+A key is timed until its table is complete, the scan itself runs on the search workers.
+usage: bench_search [rows] [query]   (default 2000000 rows, "function")
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static const char *words[] = {"fun", "function", "func", "fn", "return", "int", "for", "if", "else", "functional", "struct", "void"};
+
+static void run(const char *query, int rescan) {
+  char buf[64];
+  int qlen = strlen(query);
+  double total = 0, worst = 0;
+  for (int k = 1; k <= qlen; k++) {
+    memcpy(buf, query, k);
+    buf[k] = '\0';
+    double t0 = now();
+    if (rescan) editorFindCallback(buf, '\x1b');
+    editorFindCallback(buf, buf[k - 1]);
+    editorFindCount();
+    double t = now() - t0;
+    total += t;
+    if (t > worst) worst = t;
+  }
+  editorFindCallback(buf, '\x1b');
+  printf("%-8s %12.2f %12.2f\n", rescan ? "rescan" : "table", total * 1e3 / qlen, worst * 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  int rows = argc >= 2 ? atoi(argv[1]) : 2000000;
+  const char *query = argc >= 3 ? argv[2] : "function";
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  unsigned int x = 1;
+  for (int i = 0; i < rows; i++) {
+    char line[128];
+    int len = 0;
+    for (int w = 0; w < 6; w++) {
+      x = x * 1103515245u + 12345u;
+      len += sprintf(line + len, "%s ", words[(x >> 16) % (sizeof(words) / sizeof(words[0]))]);
+    }
+    editorInsertRow(i, line, len);
+  }
+  printf("%d rows, query \"%s\" typed a key at a time\n", rows, query);
+  printf("%-8s %12s %12s\n", "run", "ms/key", "worst ms");
+  run(query, 0);
+  run(query, 1);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include "kilo.h"
+
+/*
+bench_undo: what the undo log costs.
+The typing run types N characters, a newline every 60, and reports the bytes the log holds per key
+and the number of records, which shows how well typed keys coalesce.
+The paste run pastes M lines as one block, then times the undo and the redo of that paste,
+each of which should cost about what the paste did.
+usage: bench_undo [keys] [lines]   (default 100000 keys, 100000 lines)
+*/
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void typing(int keys) {
+  double t0 = now();
+  for (int i = 0; i < keys; i++) {
+    if (i % 60 == 59) editorInsertNewline();
+    else editorInsertChar('a' + i % 26);
+  }
+  double t1 = now();
+  int records;
+  size_t bytes = editorUndoBytes(&records);
+  printf("typing: %d keys in %.3f s, %d records, %zu bytes, %.2f bytes/key\n", keys, t1 - t0, records,
+         bytes, (double)bytes / keys);
+  editorCloseFile();
+}
+
+static void paste(int lines) {
+  struct abuf ab = ABUF_INIT;
+  for (int i = 0; i < lines; i++) {
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "line %d of the pasted block\n", i);
+    abAppend(&ab, buf, len);
+  }
+  editorInsertRow(0, "", 0);
+  E.cy = 0;
+  E.cx = 0;
+  double t0 = now();
+  editorInsertText(ab.b, ab.len);
+  double t1 = now();
+  int pasted = E.numrows;
+  editorUndo();
+  double t2 = now();
+  int undone = E.numrows;
+  editorRedo();
+  double t3 = now();
+  printf("paste:  %d lines, paste %.3f s, undo %.3f s (%d rows), redo %.3f s (%d rows)\n", lines, t1 - t0,
+         t2 - t1, undone, t3 - t2, E.numrows);
+  if (undone != 1 || E.numrows != pasted) printf("row counts are wrong\n");
+  abFree(&ab);
+  editorCloseFile();
+}
+
+int main(int argc, char *argv[]) {
+  int keys = argc >= 2 ? atoi(argv[1]) : 100000;
+  int lines = argc >= 3 ? atoi(argv[2]) : 100000;
+  E.screenrows = 24;
+  E.screencols = 80;
+  rsInit(&E.rows);
+  typing(keys);
+  paste(lines);
+  return 0;
+}
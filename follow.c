@@ -0,0 +1,276 @@
+#include "kilo.h"
+
+/*** follow ***/
+/*
+With --follow the buffer keeps up with a file that grows at its end, like tail -f on a log.
+A thread blocks on an inotify instance that watches the file, and its directory for the name coming back, and
+wakes the main loop with editorWake() when something happened. It wakes it once until the main loop has looked:
+a logger doing a thousand writes between two frames makes one WAKE_EVENT, not a thousand.
+On the WAKE_EVENT editorFollowPoll() reads only the bytes past the ones the buffer has, KILO_FOLLOW_CHUNK at a time,
+splits them with the line scanner and adds the rows with one rsAppendRows(). The mapping is left alone and nothing
+is reloaded, a poll costs what the new lines cost. When more is waiting it wakes itself again, so the main loop
+still draws a frame when one is due and keys still get in between chunks. A prompt passes the WAKE_EVENT on too,
+the lines keep coming while a search is open, only opening the file again waits until the prompt is closed.
+The new rows are the text of the file, not edits: they don't make the buffer modified and don't go into the undo
+log or the journal. A cursor on the last line or past it moves down with the new lines.
+A file that got shorter was truncated (copytruncate), a name that leads to another file now was rotated (the file
+was renamed away and a new one made). The rest of the old file is read first, then the buffer is opened again on
+what is there now. All of this counts on the end of the buffer being the end of the file, so the first edit
+stops following: after an Enter at the end or a deleted last line the rows there are not the file's any more.
+A save replaces the file too, editorFollowSaved() tells us that the file behind the name is the buffer now.
+*/
+
+static struct {
+  int enabled; // editorFollowOpen() worked, the file is being followed
+  int fd; // the file as it was opened, the name may lead to another one by now
+  off_t off; // bytes of fd that are in the buffer
+  int partial; // the last row is a line whose newline was not written yet, more of it may come
+  int jump; // put the cursor past the last row once the file is indexed
+  int ino; // the inotify instance the thread reads
+  int wd; // watch on the file
+  int dwd; // watch on its directory, for a new file with its name
+  char *name; // the last part of the file name
+  pthread_t tid;
+  int pending; // the thread woke the main loop, which did not look yet
+  int waiting; // a poll gave up because the rows were busy, editorFollowKick() wakes the main loop for another
+  char *buf; // bytes read from the file
+  erow *rows; // the rows of one chunk, before they go into the row store
+  int n;
+  int cap;
+  long lines; // rows added to the end of the buffer
+  long polls; // chunks read
+} follow = {0, -1, 0, 0, 0, -1, -1, -1, NULL, 0, 0, 0, NULL, NULL, 0, 0, 0, 0};
+
+// the thread: turn inotify events about the file into wakeups of the main loop
+static void *followWorker(void *arg) {
+  (void)arg;
+  long buf[4096 / sizeof(long)]; // aligned for struct inotify_event
+  while (1) {
+    ssize_t n = read(follow.ino, buf, sizeof(buf));
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) return NULL;
+    // anything that happened to the file, and what happened in the directory under its name
+    int wake = 0;
+    for (char *p = (char *)buf; p < (char *)buf + n;) {
+      struct inotify_event *ev = (struct inotify_event *)p;
+      if (ev->wd != follow.dwd || (ev->len && strcmp(ev->name, follow.name) == 0)) wake = 1;
+      p += sizeof(struct inotify_event) + ev->len;
+    }
+    if (wake && !__atomic_exchange_n(&follow.pending, 1, __ATOMIC_ACQ_REL)) editorWake();
+  }
+}
+
+// follow the file that is behind the name now, its first off bytes are in the buffer
+static void followArm(off_t off, int partial) {
+  if (follow.fd != -1) close(follow.fd);
+  follow.fd = open(E.filename, O_RDONLY | O_CLOEXEC);
+  follow.off = off;
+  follow.partial = partial;
+  int wd = inotify_add_watch(follow.ino, E.filename, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+  // the old file may be gone already, and its watch with it
+  if (follow.wd != -1 && wd != follow.wd) inotify_rm_watch(follow.ino, follow.wd);
+  follow.wd = wd;
+}
+
+// stop following, the thread stays blocked on what is left to watch and its wakeups find nothing to do
+static void followStop() {
+  follow.enabled = 0;
+  if (follow.wd != -1) inotify_rm_watch(follow.ino, follow.wd);
+  follow.wd = -1;
+  if (follow.fd != -1) close(follow.fd);
+  follow.fd = -1;
+}
+
+// start watching the file the buffer was opened from, it has to be a regular file
+void editorFollowOpen() {
+  if (E.filename == NULL || E.mapheap) {
+    editorSetStatusMessage("Can only follow a regular file");
+    return;
+  }
+  follow.ino = inotify_init1(IN_CLOEXEC);
+  if (follow.ino == -1) {
+    editorSetStatusMessage("Can't follow %s: %s", E.filename, strerror(errno));
+    return;
+  }
+  char *slash = strrchr(E.filename, '/');
+  char *dir = slash ? strndup(E.filename, slash == E.filename ? 1 : slash - E.filename) : strdup(".");
+  follow.name = strdup(slash ? slash + 1 : E.filename);
+  follow.buf = malloc(KILO_FOLLOW_CHUNK);
+  if (dir == NULL || follow.name == NULL || follow.buf == NULL) die("malloc");
+  follow.dwd = inotify_add_watch(follow.ino, dir, IN_CREATE | IN_MOVED_TO);
+  free(dir);
+  followArm(E.mapsize, E.mapsize > 0 && E.map[E.mapsize - 1] != '\n');
+  follow.enabled = 1;
+  follow.jump = 1; // it starts at the end, like tail -f
+  editorWakeInit();
+  if (pthread_create(&follow.tid, NULL, followWorker, NULL) != 0) die("pthread_create");
+  pthread_detach(follow.tid);
+  editorWake();
+}
+
+// a row for the len bytes at s, without the line ending, copied into the arena
+static void followRow(const char *s, size_t len) {
+  while (len > 0 && s[len - 1] == '\r') len--;
+  if (follow.n == follow.cap) {
+    follow.cap = follow.cap ? follow.cap * 2 : 1024;
+    follow.rows = realloc(follow.rows, sizeof(erow) * follow.cap);
+    if (follow.rows == NULL) die("realloc");
+  }
+  erow *row = &follow.rows[follow.n++];
+  row->size = len;
+  row->cap = arenaBlockSize(len + 1);
+  row->chars = arenaAlloc(&E.arena, row->cap);
+  memcpy(row->chars, s, len);
+  row->chars[len] = '\0';
+  row->rsize = 0;
+  row->render = NULL;
+  row->flags = 0;
+  row->ext = NULL;
+}
+
+// the rest of a line that had no newline yet goes onto the last row
+static void followFinishRow(const char *s, size_t len, int complete) {
+  erow *row = rsAt(&E.rows, E.numrows - 1);
+  editorRowMaterialize(row);
+  editorRowCloseGap(row);
+  int at = row->size;
+  row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, row->size + len + 1);
+  memcpy(&row->chars[row->size], s, len);
+  row->size += len;
+  // a \r\n cut in two by a read left the \r on the row
+  while (complete && row->size > 0 && row->chars[row->size - 1] == '\r') row->size--;
+  row->chars[row->size] = '\0';
+  editorRowChanged(row, at < row->size ? at : row->size);
+}
+
+// add the lines in len bytes read from the end of the file
+static void followAppend(const char *s, size_t len) {
+  const char *end = s + len;
+  int atEnd = E.cy >= E.numrows - 1;
+  if (follow.partial && E.numrows > 0) {
+    const char *nl = memchr(s, '\n', len);
+    followFinishRow(s, (nl ? nl : end) - s, nl != NULL);
+    follow.partial = nl == NULL;
+    s = nl ? nl + 1 : end;
+  }
+  // whole lines, and the start of one whose newline is not there yet
+  size_t offs[KILO_INDEX_BATCH];
+  follow.n = 0;
+  while (s < end) {
+    const char *base = s;
+    size_t n = lineIndexScan(base, end - base, offs, KILO_INDEX_BATCH);
+    if (n == 0) {
+      followRow(s, end - s);
+      follow.partial = 1;
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      followRow(s, base + offs[i] - s);
+      s = base + offs[i] + 1;
+    }
+  }
+  rsAppendRows(&E.rows, follow.rows, follow.n);
+  E.numrows += follow.n;
+  follow.lines += follow.n;
+  if (atEnd) {
+    E.cy = E.numrows;
+    E.cx = 0;
+  }
+}
+
+// open the buffer again on the file behind the name, the one it had was truncated or rotated
+static void followReopen(const char *why) {
+  // a prompt may hold rows of this file (the matches of a search), it looks for them again when it closes
+  if (E.prompting) {
+    follow.waiting = 1;
+    return;
+  }
+  // the new file of a rotation may not be there yet, the directory watch says when it is
+  int fd = open(E.filename, O_RDONLY);
+  if (fd == -1) return;
+  close(fd);
+  int atEnd = E.cy >= E.numrows - 1, cy = E.cy;
+  char *name = strdup(E.filename);
+  if (name == NULL) die("strdup");
+  editorCloseFile();
+  editorOpen(name);
+  free(name);
+  editorJournalOpen(0); // closing the file closed the journal too
+  followArm(E.mapsize, E.mapsize > 0 && E.map[E.mapsize - 1] != '\n');
+  follow.jump = atEnd;
+  if (!atEnd) {
+    editorIndexTo(cy);
+    E.cy = cy < E.numrows ? cy : E.numrows;
+  }
+  editorWake(); // index it to the end, then the new lines can follow
+  editorSetStatusMessage("%s was %s, opened it again", E.filename, why);
+}
+
+// called when the main loop is woken: add what was written to the file since the last look
+void editorFollowPoll() {
+  if (!follow.enabled) return;
+  __atomic_store_n(&follow.pending, 0, __ATOMIC_RELEASE);
+  if (E.dirty) {
+    followStop();
+    editorSetStatusMessage("%s has unsaved changes, not following it any more", E.filename);
+    return;
+  }
+  // a save or a search may be reading the rows. The last worker of a search wakes us, a save that finishes and a
+  // search that is cancelled call editorFollowKick(), so the lines that are waiting come in then
+  if (!editorFindIdle() || editorSaving()) {
+    follow.waiting = 1;
+    return;
+  }
+  // the new rows go after the last row of the file, so the rest of the mapping is indexed first, a step a wakeup
+  if (E.indexed < E.mapsize) {
+    editorIndexRows(INT_MAX, (size_t)KILO_INDEX_STEP * E.threads);
+    editorWake();
+    return;
+  }
+  if (follow.jump) {
+    follow.jump = 0;
+    E.cy = E.numrows;
+    E.cx = 0;
+  }
+  struct stat st;
+  if (follow.fd == -1 || fstat(follow.fd, &st) == -1) return;
+  if (st.st_size < follow.off) {
+    followReopen("truncated");
+    return;
+  }
+  if (st.st_size > follow.off) {
+    size_t want = st.st_size - follow.off;
+    if (want > KILO_FOLLOW_CHUNK) want = KILO_FOLLOW_CHUNK;
+    ssize_t n = pread(follow.fd, follow.buf, want, follow.off);
+    if (n <= 0) return;
+    followAppend(follow.buf, n);
+    follow.off += n;
+    follow.polls++;
+    // the rest after the keys and the frame that are due
+    if (follow.off < st.st_size) {
+      editorWake();
+      return;
+    }
+  }
+  // all of this file is in, if the name leads to another file now, that one is the log from here on
+  struct stat now;
+  if (stat(E.filename, &now) == 0 && (now.st_ino != st.st_ino || now.st_dev != st.st_dev)) followReopen("rotated");
+}
+
+// whatever kept the last poll from reading is over: wake the main loop (or the prompt) for another
+void editorFollowKick() {
+  if (!follow.waiting) return;
+  follow.waiting = 0;
+  editorWake();
+}
+
+// a save wrote the buffer to the file, len bytes: that file is the one to follow now
+void editorFollowSaved(size_t len) {
+  if (follow.enabled) followArm(len, 0);
+}
+
+// rows added to the end of the buffer, and in *polls the chunks they came in
+long editorFollowStats(long *polls) {
+  if (polls) *polls = follow.polls;
+  return follow.lines;
+}
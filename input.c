@@ -0,0 +1,239 @@
+#include "kilo.h"
+
+/*** input ***/
+/*
+Keys are read from the terminal in batches. Whatever stdin has is read() into a ring buffer in one call,
+and editorReadKey() decodes keys and escape sequences from the ring, so a paste or a burst of key repeats
+costs one syscall per batch instead of one per byte. When there is nothing to do we block in poll()
+without a timeout, an idle editor doesn't wake up at all.
+A bracketed paste (the terminal wraps pasted text in \x1b[200~ ... \x1b[201~) comes back as one
+PASTE_EVENT key, with the pasted bytes in E.paste.
+Worker threads can't touch the screen, when they have something for the main loop they call editorWake(),
+which writes a byte to a pipe we poll next to stdin, and the next editorReadKey() returns a WAKE_EVENT key.
+*/
+
+#define KEY_INCOMPLETE -1 // the ring holds the start of an escape sequence, more bytes are needed
+#define KEY_IGNORED -2 // a complete escape sequence we have no use for
+
+static struct {
+  unsigned char buf[KILO_INPUT_RING];
+  unsigned int head; // next byte to decode, both counters run freely and are masked on access
+  unsigned int tail; // next free byte
+  int woken; // a WAKE_EVENT is waiting to be returned
+} in;
+
+static int wakePipe[2] = {-1, -1}; // written by editorWake(), read end polled with stdin
+
+static int inputLen() {
+  return in.tail - in.head;
+}
+
+static int inputPeek(int i) {
+  return in.buf[(in.head + i) & (KILO_INPUT_RING - 1)];
+}
+
+static void inputConsume(int n) {
+  in.head += n;
+}
+
+// wait up to timeout ms (-1 forever) for stdin and read what it has into the ring,
+// returns 1 if bytes arrived or a worker woke us up
+int editorFillInput(int timeout) {
+  if (inputLen() == KILO_INPUT_RING) return 1;
+  struct pollfd pfd[2] = {{STDIN_FILENO, POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+  int r = poll(pfd, wakePipe[0] != -1 ? 2 : 1, timeout);
+  if (r == -1 && errno != EINTR) die("poll");
+  if (r <= 0) return 0;
+  if (wakePipe[0] != -1 && pfd[1].revents) {
+    // any number of wakeups is one event, the receiver looks at everything that is new
+    char drain[64];
+    while (read(wakePipe[0], drain, sizeof(drain)) > 0);
+    in.woken = 1;
+    if (pfd[0].revents == 0) return 1;
+  }
+  // read up to the end of the buffer or the free space, whichever comes first, the rest comes next call
+  unsigned int pos = in.tail & (KILO_INPUT_RING - 1);
+  size_t room = KILO_INPUT_RING - inputLen();
+  if (room > KILO_INPUT_RING - pos) room = KILO_INPUT_RING - pos;
+  ssize_t n = read(STDIN_FILENO, &in.buf[pos], room);
+  if (n == -1 && errno != EAGAIN && errno != EINTR) die("read");
+  // poll said readable but there is nothing: the terminal went away
+  if (n == 0) exit(1);
+  if (n <= 0) return in.woken;
+  // remember when the first key that is not on the screen yet arrived, see editorRefreshScreen()
+  if (E.inputTime == 0) E.inputTime = editorNow();
+  in.tail += n;
+  return 1;
+}
+
+// make the wake pipe, before the first worker that calls editorWake() starts
+void editorWakeInit() {
+  if (wakePipe[0] != -1) return;
+  if (pipe(wakePipe) == -1) die("pipe");
+  for (int i = 0; i < 2; i++) {
+    fcntl(wakePipe[i], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[i], F_SETFD, FD_CLOEXEC);
+  }
+}
+
+// called from a worker thread: make the main loop return a WAKE_EVENT key. When the pipe is full
+// the main loop has wakeups waiting already, so a failed write is fine
+void editorWake() {
+  ssize_t r = write(wakePipe[1], "", 1);
+  (void)r;
+}
+
+// check whether a key is waiting without blocking
+int editorInputPending() {
+  return inputLen() > 0 || in.woken || editorFillInput(0);
+}
+
+// wait for input until deadline (from editorNow()), returns 1 if there is a key to handle before then
+int editorInputBefore(long deadline) {
+  if (editorInputPending()) return 1;
+  long wait = deadline - editorNow();
+  if (wait <= 0) return 0;
+  return editorFillInput((wait + 999) / 1000);
+}
+
+// monotonic clock in microseconds
+long editorNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+// decode one key from the front of the ring
+static int editorDecodeKey() {
+  int n = inputLen();
+  if (n == 0) return KEY_INCOMPLETE;
+  int c = inputPeek(0);
+  if (c != '\x1b') {
+    inputConsume(1);
+    return c;
+  }
+  if (n == 1) return KEY_INCOMPLETE;
+
+  int c1 = inputPeek(1);
+  if (c1 == '[') {
+    // CSI: parameter bytes, then a final byte between '@' and '~'
+    int i = 2, param = 0;
+    while (i < n && (inputPeek(i) < 0x40 || inputPeek(i) > 0x7e)) {
+      int d = inputPeek(i);
+      if (d >= '0' && d <= '9' && param < 10000) param = param * 10 + d - '0';
+      if (++i > 32) {
+        // not a sequence any terminal sends, treat the escape as a key of its own
+        inputConsume(1);
+        return '\x1b';
+      }
+    }
+    if (i == n) return KEY_INCOMPLETE;
+    int final = inputPeek(i);
+    inputConsume(i + 1);
+    switch (final) {
+      case 'A': return ARROW_UP;
+      case 'B': return ARROW_DOWN;
+      case 'C': return ARROW_RIGHT;
+      case 'D': return ARROW_LEFT;
+      case 'H': return HOME_KEY;
+      case 'F': return END_KEY;
+      case '~':
+        //home key and end key have multiple escape sequences, so we need to handle them separately
+        switch (param) {
+          case 1: case 7: return HOME_KEY;
+          case 3: return DEL_KEY;
+          case 4: case 8: return END_KEY;
+          case 5: return PAGE_UP;
+          case 6: return PAGE_DOWN;
+          case 200: return PASTE_EVENT;
+        }
+    }
+    return KEY_IGNORED;
+  } else if (c1 == 'O') {
+    if (n < 3) return KEY_INCOMPLETE;
+    int c2 = inputPeek(2);
+    inputConsume(3);
+    switch (c2) {
+      case 'A': return ARROW_UP;
+      case 'B': return ARROW_DOWN;
+      case 'C': return ARROW_RIGHT;
+      case 'D': return ARROW_LEFT;
+      case 'H': return HOME_KEY;
+      case 'F': return END_KEY;
+    }
+    return KEY_IGNORED;
+  }
+  // escape followed by something else (alt + key), report the escape and leave the key for next time
+  inputConsume(1);
+  return '\x1b';
+}
+
+// collect the pasted text that follows \x1b[200~ into E.paste, up to the closing \x1b[201~
+static void editorReadPaste() {
+  static const char end[] = "\x1b[201~";
+  int matched = 0; // bytes of the closing sequence seen so far
+  abReset(&E.paste);
+  while (1) {
+    int n = inputLen();
+    int i;
+    for (i = 0; i < n; i++) {
+      int c = inputPeek(i);
+      if (c == end[matched]) {
+        if (++matched == (int)sizeof(end) - 1) break;
+      } else {
+        // a partial match turned out to be text, keep it
+        if (matched) abAppend(&E.paste, end, matched);
+        matched = c == end[0];
+        if (!matched) {
+          char ch = c;
+          abAppend(&E.paste, &ch, 1);
+        }
+      }
+    }
+    if (i < n) {
+      inputConsume(i + 1);
+      return;
+    }
+    inputConsume(n);
+    editorFillInput(-1);
+  }
+}
+
+// block until there is input, doing background work and expiring the status message meanwhile
+static void editorWaitForInput() {
+  // while the user is idle, keep splitting the rest of the mapped file into rows
+  editorIndexInBackground();
+  if (inputLen() > 0 || in.woken) return;
+  int timeout = -1;
+  if (E.statusmsg[0] && time(NULL) - E.statusmsg_time < 5)
+    timeout = (E.statusmsg_time + 5 - time(NULL)) * 1000;
+  // when the status message times out, repaint so it disappears
+  if (!editorFillInput(timeout) && timeout != -1) editorRefreshScreen();
+}
+
+//this function job is to keep reading the input and then return the next key
+int editorReadKey() {
+  while (1) {
+    int key = editorDecodeKey();
+    if (key == PASTE_EVENT) editorReadPaste();
+    if (key >= 0) {
+      E.frameKeys++;
+      return key;
+    }
+    if (key == KEY_IGNORED) continue;
+    if (inputLen() > 0) {
+      // the start of an escape sequence, if the rest doesn't follow shortly it was the escape key
+      if (!editorFillInput(KILO_ESC_TIMEOUT)) {
+        inputConsume(1);
+        return '\x1b';
+      }
+      continue;
+    }
+    if (in.woken) {
+      // not a key, so it doesn't count in E.frameKeys
+      in.woken = 0;
+      return WAKE_EVENT;
+    }
+    editorWaitForInput();
+  }
+}
@@ -0,0 +1,450 @@
+#include "kilo.h"
+
+/*** journal ***/
+/*
+Everything typed since the last save is also written to a journal next to the file, .name.kswp, so a crash or a
+dropped connection loses at most the last KILO_JOURNAL_MS of it. The journal is the list of edits in the order
+they were made, the same operations the editor made them with: a key typed, Enter or backspace at a cursor
+position, a block of text inserted or deleted, a replace-all, a row added or removed by undo. Nothing else changes
+the text, so the file on disk plus the journal gives back the buffer.
+Appending a record only copies it into a buffer, a thread writes the buffer out and fdatasync()s it. It waits
+KILO_JOURNAL_MS after the first record before doing so, every key typed in that time goes to disk with one write
+and one sync (a group commit), so a key costs the editor a memcpy and never waits for the disk.
+Every record has its length and a checksum in front, a record cut short by the crash fails the check and
+recovery stops before it. The journal starts with the size, mtime and inode of the file the edits were made to,
+and is only replayed over that same file.
+The journal is made by the first edit to a clean buffer, and goes away when the buffer is saved or the editor
+quits. One that is there when a file is opened was left by a session that never quit: kilo --recover replays it,
+without that the editor leaves it alone and keeps no journal of its own.
+*/
+
+#define JOURNAL_MAGIC "KILOJRN1"
+
+// what the edits were made to, the first bytes of the journal
+struct journalHead {
+  char magic[8];
+  uint64_t size;
+  int64_t sec, nsec; // mtime
+  uint64_t ino, dev;
+};
+
+// in front of every record: the bytes after this and their checksum, then op, cy, cx and n as int32,
+// then the text of the record if it has one
+#define JOURNAL_REC (8 + 1 + 4 * 3)
+
+static struct {
+  int enabled; // editorJournalOpen() was called, edits are journaled
+  int kept; // a journal from another session is in the way, this one keeps none
+  int replaying; // 1 while recovery makes the edits, they are in the journal already
+  char *path;
+  int fd; // -1 until the first edit makes the journal
+  size_t size; // bytes of the journal, the ones still in buf included
+  struct abuf buf; // records not handed to the thread yet
+  struct abuf spare; // records the thread is writing
+  pthread_t tid;
+  int thread; // the thread was started
+  pthread_mutex_t lock;
+  pthread_cond_t more; // the thread waits on it for records
+  pthread_cond_t synced; // editorJournalSync() waits on it for the thread
+  long first; // when the oldest record in buf was added
+  int stop, flush; // ask the thread to quit, to write right away
+  size_t appended, durable; // bytes handed to the thread, and those of them on disk
+  long records, syncs;
+  int err; // errno of a failed write, the journal is given up
+} journal = {.fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER};
+
+// FNV-1a, cheap for the few bytes of a key
+static uint32_t journalHash(uint32_t h, const char *s, size_t len) {
+  for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+  return h;
+}
+
+static void *journalWorker(void *arg) {
+  (void)arg;
+  pthread_mutex_lock(&journal.lock);
+  while (1) {
+    while (journal.buf.len == 0 && !journal.stop) pthread_cond_wait(&journal.more, &journal.lock);
+    if (journal.buf.len == 0) break;
+    // the group commit: let the records of the next KILO_JOURNAL_MS join this one
+    long due = journal.first + KILO_JOURNAL_MS * 1000L;
+    struct timespec until = {due / 1000000, due % 1000000 * 1000};
+    while (!journal.stop && !journal.flush && journal.buf.len < KILO_JOURNAL_BATCH)
+      if (pthread_cond_timedwait(&journal.more, &journal.lock, &until) == ETIMEDOUT) break;
+    struct abuf out = journal.buf;
+    journal.buf = journal.spare;
+    journal.spare = out;
+    journal.flush = 0;
+    int fd = journal.fd;
+    pthread_mutex_unlock(&journal.lock);
+
+    int err = 0;
+    for (int done = 0; done < out.len && err == 0;) {
+      ssize_t w = write(fd, out.b + done, out.len - done);
+      if (w == -1) {
+        if (errno != EINTR) err = errno;
+        continue;
+      }
+      done += w;
+    }
+    if (err == 0 && fdatasync(fd) == -1) err = errno;
+
+    pthread_mutex_lock(&journal.lock);
+    journal.spare.len = 0;
+    journal.durable += out.len;
+    journal.syncs++;
+    if (err) __atomic_store_n(&journal.err, err, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&journal.synced);
+  }
+  pthread_mutex_unlock(&journal.lock);
+  return NULL;
+}
+
+static void journalStartThread() {
+  if (journal.thread) return;
+  // the group commit waits on the monotonic clock, editorNow() is that clock too
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&journal.more, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_cond_init(&journal.synced, NULL);
+  journal.stop = 0;
+  if (pthread_create(&journal.tid, NULL, journalWorker, NULL) != 0) die("pthread_create");
+  journal.thread = 1;
+}
+
+// hand len bytes to the thread, with journal.lock held
+static void journalAdd(const char *s, int len) {
+  if (journal.buf.len == 0) {
+    journal.first = editorNow();
+    pthread_cond_signal(&journal.more);
+  }
+  abAppend(&journal.buf, s, len);
+  if (journal.buf.len >= KILO_JOURNAL_BATCH) pthread_cond_signal(&journal.more);
+  journal.appended += len;
+  journal.size += len;
+}
+
+// .name.kswp next to the file
+static void journalPath() {
+  free(journal.path);
+  const char *slash = strrchr(E.filename, '/');
+  int dirlen = slash ? slash - E.filename + 1 : 0;
+  size_t size = strlen(E.filename) + 7;
+  journal.path = malloc(size);
+  if (journal.path == NULL) die("malloc");
+  snprintf(journal.path, size, "%.*s.%s.kswp", dirlen, E.filename, E.filename + dirlen);
+}
+
+static void journalHeadOf(struct journalHead *h, struct stat *st) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, JOURNAL_MAGIC, 8);
+  h->size = st->st_size;
+  h->sec = st->st_mtim.tv_sec;
+  h->nsec = st->st_mtim.tv_nsec;
+  h->ino = st->st_ino;
+  h->dev = st->st_dev;
+}
+
+// make the journal for the edits about to be made to a clean buffer, returns 0 when there will be none
+static int journalCreate() {
+  // a buffer that is not what the file holds has edits the journal never saw, it waits for the next save
+  if (E.dirty || E.filename == NULL || E.mapheap || journal.kept) return 0;
+  if (journal.path == NULL) journalPath();
+  int fd = open(journal.path, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1) {
+    if (errno == EEXIST) {
+      journal.kept = 1;
+      editorSetStatusMessage("%s is in the way, edits are not journaled", journal.path);
+    }
+    return 0;
+  }
+  struct journalHead h;
+  journalHeadOf(&h, &E.mapstat);
+  journalStartThread();
+  pthread_mutex_lock(&journal.lock);
+  journal.fd = fd;
+  journal.size = 0;
+  journalAdd((char *)&h, sizeof(h));
+  pthread_mutex_unlock(&journal.lock);
+  return 1;
+}
+
+// journal an edit before it is made: op at row cy, column cx, with len bytes of text s, or a count len when s is NULL
+void editorJournal(int op, int cy, int cx, const char *s, int len) {
+  if (!journal.enabled || journal.replaying) return;
+  if (journal.fd == -1 && !journalCreate()) return;
+  int err = __atomic_load_n(&journal.err, __ATOMIC_RELAXED);
+  if (err) {
+    editorSetStatusMessage("Journal write failed: %s, edits are not journaled", strerror(err));
+    editorJournalClose(0);
+    return;
+  }
+  int32_t f[3] = {cy, cx, len};
+  int tlen = s ? len : 0;
+  char rec[JOURNAL_REC];
+  uint32_t plen = JOURNAL_REC - 8 + tlen;
+  rec[8] = op;
+  memcpy(rec + 9, f, sizeof(f));
+  uint32_t h = journalHash(journalHash(2166136261u, rec + 8, JOURNAL_REC - 8), s, tlen);
+  memcpy(rec, &plen, 4);
+  memcpy(rec + 4, &h, 4);
+  pthread_mutex_lock(&journal.lock);
+  journalAdd(rec, JOURNAL_REC);
+  if (tlen) journalAdd(s, tlen);
+  journal.records++;
+  pthread_mutex_unlock(&journal.lock);
+}
+
+// journal a replace-all: the spans as row, col, len, tlen followed by their text
+void editorJournalSpans(struct replaceSpan *spans, int n) {
+  if (!journal.enabled || journal.replaying || n == 0) return;
+  struct abuf text = ABUF_INIT;
+  for (int i = 0; i < n; i++) {
+    int32_t f[4] = {spans[i].row, spans[i].col, spans[i].len, spans[i].tlen};
+    abAppend(&text, (char *)f, sizeof(f));
+    abAppend(&text, spans[i].text, spans[i].tlen);
+  }
+  // the spans go as the text of one record, with their number where the others have cy
+  editorJournal(JOURNAL_REPLACE, n, 0, text.b, text.len);
+  abFree(&text);
+}
+
+// wait until every record journaled so far is on disk
+void editorJournalSync() {
+  if (!journal.thread) return;
+  pthread_mutex_lock(&journal.lock);
+  size_t want = journal.appended;
+  journal.flush = 1;
+  pthread_cond_signal(&journal.more);
+  while (journal.durable < want) pthread_cond_wait(&journal.synced, &journal.lock);
+  pthread_mutex_unlock(&journal.lock);
+}
+
+// the buffer was saved and is clean, the journal is not needed any more, the next edit starts a new one
+void editorJournalReset() {
+  if (journal.fd == -1) return;
+  editorJournalSync();
+  pthread_mutex_lock(&journal.lock);
+  close(journal.fd);
+  journal.fd = -1;
+  journal.size = 0;
+  pthread_mutex_unlock(&journal.lock);
+  unlink(journal.path);
+}
+
+// where the journal is now, a background save passes it to editorJournalRebase() once the file is written
+size_t editorJournalMark() {
+  return journal.fd != -1 ? journal.size : sizeof(struct journalHead);
+}
+
+// the file st was saved with the edits journaled up to mark, keep only the ones after it, as edits to that file.
+// The new journal is written next to the old one and renamed over it, a crash leaves one of the two
+void editorJournalRebase(size_t mark, struct stat *st) {
+  if (journal.fd == -1) return;
+  editorJournalSync();
+  if (mark > journal.size) mark = journal.size;
+  size_t size = strlen(journal.path) + 8;
+  char *tmp = malloc(size);
+  if (tmp == NULL) die("malloc");
+  snprintf(tmp, size, "%s.XXXXXX", journal.path);
+  int fd = mkstemp(tmp);
+  struct journalHead h;
+  journalHeadOf(&h, st);
+  int ok = fd != -1 && fchmod(fd, 0600) == 0 && write(fd, &h, sizeof(h)) == sizeof(h);
+  char buf[65536];
+  for (size_t off = mark; ok && off < journal.size;) {
+    ssize_t n = pread(journal.fd, buf, sizeof(buf), off);
+    ok = n > 0 && write(fd, buf, n) == n;
+    off += n;
+  }
+  if (ok && fdatasync(fd) == 0 && rename(tmp, journal.path) == 0) {
+    pthread_mutex_lock(&journal.lock);
+    close(journal.fd);
+    journal.fd = fd;
+    journal.size = sizeof(h) + journal.size - mark;
+    pthread_mutex_unlock(&journal.lock);
+  } else {
+    // the old journal stays, recovery will find it does not match the saved file and leave it alone
+    if (fd != -1) close(fd);
+    unlink(tmp);
+  }
+  free(tmp);
+}
+
+// stop journaling, the journal is removed or, when the edits were not saved on purpose, kept
+void editorJournalClose(int remove) {
+  if (journal.thread) {
+    pthread_mutex_lock(&journal.lock);
+    journal.stop = 1;
+    pthread_cond_signal(&journal.more);
+    pthread_mutex_unlock(&journal.lock);
+    pthread_join(journal.tid, NULL);
+    journal.thread = 0;
+    pthread_cond_destroy(&journal.more);
+    pthread_cond_destroy(&journal.synced);
+  }
+  if (journal.fd != -1) {
+    close(journal.fd);
+    if (remove) unlink(journal.path);
+  }
+  journal.fd = -1;
+  journal.enabled = journal.kept = journal.err = 0;
+  journal.size = journal.appended = journal.durable = 0;
+  abFree(&journal.buf);
+  abFree(&journal.spare);
+  free(journal.path);
+  journal.path = NULL;
+}
+
+// the cursor of a key edit is somewhere the key could have been pressed
+static int journalAt(int cy, int cx) {
+  if (cy < 0 || cy > E.numrows || cx < 0) return 0;
+  return cx <= (cy < E.numrows ? rsAt(&E.rows, cy)->size : 0);
+}
+
+// make the edit of one record again, returns 0 when it does not fit the buffer
+static int journalReplay(int op, int cy, int cx, int n, const char *text, int tlen) {
+  switch (op) {
+    case JOURNAL_CHAR:
+    case JOURNAL_NEWLINE:
+    case JOURNAL_DELCHAR:
+      if (!journalAt(cy, cx) || (op == JOURNAL_CHAR && tlen != 1)) return 0;
+      E.cy = cy;
+      E.cx = cx;
+      if (op == JOURNAL_CHAR) editorInsertChar((unsigned char)text[0]);
+      else if (op == JOURNAL_NEWLINE) editorInsertNewline();
+      else editorDelChar();
+      return 1;
+    case JOURNAL_INSERT:
+      if (!journalAt(cy, cx) || tlen != n) return 0;
+      E.cy = cy;
+      E.cx = cx;
+      editorInsertText(text, tlen);
+      return 1;
+    case JOURNAL_DELETE:
+      if (!journalAt(cy, cx) || tlen != 0) return 0;
+      editorDeleteText(cy, cx, n);
+      return 1;
+    case JOURNAL_ROW:
+      if (cy < 0 || cy > E.numrows) return 0;
+      editorInsertRow(cy, "", 0);
+      return 1;
+    case JOURNAL_DELROW:
+      if (cy < 0 || cy >= E.numrows) return 0;
+      editorDelRow(cy);
+      return 1;
+    case JOURNAL_REPLACE: {
+      struct replaceSpan *spans = malloc(sizeof(struct replaceSpan) * (cy > 0 ? cy : 1));
+      if (spans == NULL) die("malloc");
+      int ok = cy > 0, at = 0;
+      for (int i = 0; ok && i < cy; i++) {
+        int32_t f[4];
+        ok = at + (int)sizeof(f) <= tlen;
+        if (!ok) break;
+        memcpy(f, text + at, sizeof(f));
+        at += sizeof(f);
+        spans[i] = (struct replaceSpan){f[0], f[1], f[2], text + at, f[3]};
+        at += f[3];
+        ok = f[0] >= 0 && f[0] < E.numrows && f[1] >= 0 && f[2] >= 0 && f[3] >= 0 && at <= tlen &&
+             f[1] + f[2] <= rsAt(&E.rows, f[0])->size &&
+             (i == 0 || f[0] > spans[i - 1].row || f[1] >= spans[i - 1].col + spans[i - 1].len);
+      }
+      if (ok) editorReplaceSpans(spans, cy);
+      free(spans);
+      return ok;
+    }
+  }
+  return 0;
+}
+
+// start journaling the edits to E.filename. With recover, a journal left by a session that never quit
+// is replayed over the file first, and the editor goes on adding to it
+void editorJournalOpen(int recover) {
+  journal.enabled = 1;
+  if (E.filename == NULL) {
+    if (recover) editorSetStatusMessage("No file to recover");
+    return;
+  }
+  journalPath();
+  int fd = open(journal.path, O_RDWR);
+  if (fd == -1) {
+    if (recover) editorSetStatusMessage("Nothing to recover, there is no %s", journal.path);
+    return;
+  }
+  if (!recover) {
+    close(fd);
+    journal.kept = 1;
+    editorSetStatusMessage("%s has edits that were never saved, kilo --recover replays them", journal.path);
+    return;
+  }
+  struct stat st;
+  char *data = NULL;
+  size_t len = 0;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct journalHead)) {
+    len = st.st_size;
+    data = malloc(len);
+    if (data == NULL) die("malloc");
+    for (size_t got = 0; got < len;) {
+      ssize_t n = pread(fd, data + got, len - got, got);
+      if (n <= 0) {
+        len = got;
+        break;
+      }
+      got += n;
+    }
+  }
+  struct journalHead want;
+  journalHeadOf(&want, &E.mapstat);
+  if (data == NULL || len < sizeof(want) || memcmp(data, &want, sizeof(want)) != 0) {
+    close(fd);
+    free(data);
+    journal.kept = 1;
+    editorSetStatusMessage("%s is not for this version of the file, not replayed", journal.path);
+    return;
+  }
+
+  // every row can be edited, and the line past the end is where it is when the whole file is indexed
+  editorIndexTo(INT_MAX);
+  long t0 = editorNow();
+  size_t at = sizeof(want);
+  int edits = 0;
+  journal.replaying = 1;
+  while (at + JOURNAL_REC <= len) {
+    uint32_t plen, h;
+    memcpy(&plen, data + at, 4);
+    memcpy(&h, data + at + 4, 4);
+    if (plen < JOURNAL_REC - 8 || plen > len - at - 8) break; // cut short by the crash
+    const char *p = data + at + 8;
+    if (journalHash(2166136261u, p, plen) != h) break;
+    int32_t f[3];
+    memcpy(f, p + 1, sizeof(f));
+    if (!journalReplay(p[0], f[0], f[1], f[2], p + JOURNAL_REC - 8, plen - (JOURNAL_REC - 8))) break;
+    at += 8 + plen;
+    edits++;
+  }
+  journal.replaying = 0;
+  free(data);
+  // the recovered text is where undo starts, the journal goes on after the last good record
+  editorUndoClear();
+  E.cx = E.cy = 0;
+  if (ftruncate(fd, at) == -1 || lseek(fd, at, SEEK_SET) == -1) {
+    close(fd);
+    journal.kept = 1;
+  } else {
+    journal.fd = fd;
+    journal.size = at;
+    journalStartThread();
+  }
+  editorSetStatusMessage("Recovered %d edits in %ld ms, Ctrl-S to keep them", edits, (editorNow() - t0) / 1000);
+}
+
+// bytes journaled, with the number of records in *records and of the group commits that wrote them in *syncs
+size_t editorJournalStats(long *records, long *syncs) {
+  pthread_mutex_lock(&journal.lock);
+  if (records) *records = journal.records;
+  if (syncs) *syncs = journal.syncs;
+  size_t bytes = journal.appended;
+  pthread_mutex_unlock(&journal.lock);
+  return bytes;
+}
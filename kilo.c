@@ -1,23 +1,51 @@
 #include "kilo.h"  
+
+struct editorConfig E;
+
 //Control characters are nonprintable characters that we don’t want to print to the screen (ASCII codes 0–31,127)
 //https://viewsourcecode.org/snaptoken/kilo/index.html
 
-void abAppend(struct abuf *ab, const char *s, int len){
+long abAllocs = 0; // number of times an append buffer went to the heap, shown by Ctrl-T
 
+// make room for len more bytes, the capacity doubles so appending n bytes costs O(log n) reallocs at most
+static int abReserve(struct abuf *ab, int len) {
+  if (ab->len + len <= ab->cap) return 1;
+  int cap = ab->cap ? ab->cap : 64;
+  while (cap < ab->len + len) cap *= 2;
   //realloc is used to change the size of the previously allocated memory size
-  char *new = realloc(ab->b,ab->len + len);
+  char *new = realloc(ab->b, cap);
+  if (new == NULL) return 0;
+  abAllocs++;
+  ab->b = new;
+  ab->cap = cap;
+  return 1;
+}
 
+void abAppend(struct abuf *ab, const char *s, int len){
+  if (!abReserve(ab, len)) return;
   //memcpy is used to copy len bytes from the memory location pointed by s to the memory location pointed by b
   //this function is used to append a string to the buffer
-  if(new == NULL) return;
-  memcpy(&new[ab->len], s, len);
-  ab->b = new;
+  memcpy(&ab->b[ab->len], s, len);
   ab->len += len;
 }
 
+// append n copies of the character c, used for padding
+void abFill(struct abuf *ab, char c, int n) {
+  if (n <= 0 || !abReserve(ab, n)) return;
+  memset(&ab->b[ab->len], c, n);
+  ab->len += n;
+}
+
+// empty the buffer but keep its memory, so the next frame can reuse it without allocating
+void abReset(struct abuf *ab) {
+  ab->len = 0;
+}
+
 //destructor that deallocates the dynamic memory used by an abuf
 void abFree(struct abuf *ab) {
   free(ab->b);
+  ab->b = NULL;
+  ab->len = ab->cap = 0;
 }
 
 /*** terminal ****/
@@ -31,69 +59,9 @@ void die(const char *s) {
 }
 
 
-//this function job is to keep reading the input and then return that char
-int editorReadKey() {
-  int nread;
-  char c;
-  //read() is used to read a single character from the standard input (stdin)
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-    // handle error when reading from stdin
-    if (nread == -1 && errno != EAGAIN) die("read");
-  }
-  // \x1b is the escape character, \x1b[H is a sequence to move the cursor to the top left corner of the screen
-  if (c == '\x1b') {
-    char seq[3];
-    if (read(STDIN_FILENO, &seq[0], 1) != 1) return '\x1b';
-    if (read(STDIN_FILENO, &seq[1], 1) != 1) return '\x1b';
-    if (seq[0] == '[') {
-      //handling pg up and pg down key
-      //seq[1] is the first digit of the sequence, seq[2] is the second digit, and seq[3] is the third digit.
-      //if the third digit is '~', it’s a special sequence for page up and page down.
-      //we only care about the first two digits for this case.
-      //if seq[1] is between '0' and '9', it’s a number, and we read the third digit to determine the direction.
-      //if seq[1] is not between '0' and '9', it’s an arrow key, and we use a switch statement to determine the direction.
-      //we use the arrow keys to navigate through the text editor.
-      //the arrow keys are represented by the ASCII codes for the arrow keys.
-      //we use the arrow key codes to determine the direction.
-      if (seq[1] >= '0' && seq[1] <= '9') {
-        if (read(STDIN_FILENO, &seq[2], 1) != 1) return '\x1b';
-        if (seq[2] == '~') {
-          //home key and end key have multiple escape sequences, so we need to handle them separately
-          switch (seq[1]) {
-            case '1': return HOME_KEY; //here
-            case '3': return DEL_KEY; //handle delete key <esc>[3~,.
-            case '4': return END_KEY;
-            case '5': return PAGE_UP;
-            case '6': return PAGE_DOWN;
-            case '7': return HOME_KEY; //here
-            case '8': return END_KEY;
-          }
-        }
-      } else {
-        //use the arrow keys to navigate through the text editor
-        switch (seq[1]) {
-          case 'A': return ARROW_UP;
-          case 'B': return ARROW_DOWN;
-          case 'C': return ARROW_RIGHT;
-          case 'D': return ARROW_LEFT;
-          case 'H': return HOME_KEY;
-          case 'F': return END_KEY;
-        }
-      }
-    }else if (seq[0] == 'O') {
-      switch (seq[1]) {
-        case 'H': return HOME_KEY;
-        case 'F': return END_KEY;
-      }
-      
-    }
-    return '\x1b';
-  } else {
-    return c;
-  }
-}
-
 void disableRawMode() {
+  // stop wrapping pastes in \x1b[200~ ... \x1b[201~, the shell doesn't expect it
+  write(STDOUT_FILENO, "\x1b[?2004l", 8);
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
     die("tcsetattr");
 }
@@ -144,38 +112,283 @@ void enableRawMode() {
 
   // Modify control characters (c_cc)
   raw.c_cc[VMIN] = 0;  // Minimum number of bytes before read() can return
-  raw.c_cc[VTIME] = 1; // Maximum time to wait before read() returns
+  raw.c_cc[VTIME] = 0; // read() never waits, we wait in poll() instead (see input.c)
 
   // Apply the modified attributes to the terminal
   if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1) die("tcsetattr");
+
+  // ask the terminal to mark pasted text, so a paste arrives as one PASTE_EVENT instead of many keys
+  write(STDOUT_FILENO, "\x1b[?2004h", 8);
 }
 
 
+/*** file i/o ***/
+/*
+Opening a file maps it into memory instead of copying it line by line.
+Only the lines needed for the first screen are split into rows right away, each row just points into the mapping.
+The rest of the file is indexed on demand (when the cursor or a search needs it) or in the background while the user is idle.
+A row gets its own copy of the text only when it is edited, see editorRowMaterialize().
+A file bigger than memory is opened with --max-resident: the index then only notes where every KILO_PAGE_ROWS rows
+start, a page of rows is made when it is looked at and dropped again, with the pages of the mapping under it,
+when the pages that are in take more than E.maxResident bytes. Edited rows stay, the file is saved from where
+the text is like any other. See rowstore.c.
+*/
 void editorOpen(char *filename) {
   free(E.filename);
   E.filename = strdup(filename);
-  FILE *fp = fopen(filename, "r");
-  if (!fp) die("fopen");
-  char *line = NULL;
-  size_t linecap = 0;
-  ssize_t linelen;
-  while ((linelen = getline(&line, &linecap, fp)) != -1) {
-    while (linelen > 0 && (line[linelen - 1] == '\n' ||
-                           line[linelen - 1] == '\r'))
-      linelen--;
-        editorInsertRow(E.numrows, line, linelen);
-  }
-  free(line);
-  fclose(fp);
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) die("open");
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    E.mapsize = st.st_size;
+    E.mapstat = st;
+    E.indexed = 0;
+    E.map = NULL;
+    E.mapheap = 0;
+    if (E.mapsize > 0) {
+      E.map = mmap(NULL, E.mapsize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (E.map == MAP_FAILED) die("mmap");
+    }
+    close(fd);
+    // index just enough rows for the first frame, time to first paint doesn't depend on the file size
+    editorIndexTo(E.screenrows);
+    E.dirty = 0;
+    return;
+  }
+
+  // not a regular file (a pipe, /dev/stdin ...), it can't be mapped so read it into memory and index that instead
+  size_t cap = 1 << 16;
+  E.map = malloc(cap);
+  E.mapsize = E.indexed = 0;
+  E.mapheap = 1;
+  memset(&E.mapstat, 0, sizeof(E.mapstat));
+  ssize_t nread;
+  while ((nread = read(fd, E.map + E.mapsize, cap - E.mapsize)) > 0) {
+    E.mapsize += nread;
+    if (E.mapsize == cap) {
+      cap *= 2;
+      E.map = realloc(E.map, cap);
+      if (E.map == NULL) die("realloc");
+    }
+  }
+  if (nread == -1) die("read");
+  close(fd);
+  editorIndexTo(E.screenrows);
   E.dirty = 0;
 }
 
+// add a row at the end of the file that points at len bytes of the mapping, without the line ending
+static void editorAppendMappedRow(char *p, size_t len) {
+  // strip the line ending, \r\n files end every line with a carriage return
+  while (len > 0 && p[len - 1] == '\r') len--;
+  erow *row = rsInsert(&E.rows, E.numrows);
+  row->size = len;
+  row->chars = p;
+  row->rsize = 0;
+  row->render = NULL;
+  row->flags = ROW_MAPPED;
+  row->cap = 0;
+  row->ext = NULL;
+  E.numrows++;
+}
+
+// make n rows, at most max, for the lines of the mapping from *p on, that end before end; *p moves past them
+int editorPageRows(const char **p, const char *end, erow *rows, int max) {
+  const char *s = *p;
+  int n = 0;
+  while (n < max && s < end) {
+    const char *nl = memchr(s, '\n', end - s);
+    size_t len = (nl ? nl : end) - s;
+    while (len > 0 && s[len - 1] == '\r') len--;
+    erow *row = &rows[n++];
+    row->size = len;
+    row->chars = (char *)s;
+    row->rsize = 0;
+    row->render = NULL;
+    row->flags = ROW_MAPPED;
+    row->cap = 0;
+    row->ext = NULL;
+    s = nl ? nl + 1 : end;
+  }
+  *p = s;
+  return n;
+}
+
+// the mapping can give back the memory of len bytes of text at p, they are read from the file again when needed
+static void editorPageDrop(const char *p, size_t len) {
+  if (E.mapheap || len == 0) return;
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t from = ((uintptr_t)p + page - 1) & ~(page - 1);
+  uintptr_t to = ((uintptr_t)p + len) & ~(page - 1);
+  if (to > from) madvise((void *)from, to - from, MADV_DONTNEED);
+}
+
+// rsTrim() pages out n rows: if they are still the text of the file, one after another in the mapping, free what
+// they hold and put where their text is in *base and *len. Returns 0 when an edit is in them, they stay
+int editorPageOut(erow *rows, int n, char **base, size_t *len) {
+  char *p = rows[0].chars, *end = E.map + E.mapsize;
+  if (E.map == NULL || p < E.map || p > end) return 0;
+  for (int i = 0; i < n; i++) {
+    if (!(rows[i].flags & ROW_MAPPED) || rows[i].chars != p) return 0;
+    p += rows[i].size;
+    while (p < end && *p == '\r') p++;
+    if (p < end && *p++ != '\n') return 0;
+  }
+  for (int i = 0; i < n; i++) editorFreeRow(&rows[i]);
+  *base = rows[0].chars;
+  *len = p - rows[0].chars;
+  editorPageDrop(*base, *len);
+  return 1;
+}
+
+// keep the pages of a file opened with --max-resident within E.maxResident, called between frames
+void editorPageTrim() {
+  if (E.maxResident == 0 || E.rows.resident <= E.maxResident) return;
+  // search workers read the rows of the pages, they wait until the search is over
+  if (!editorFindIdle()) return;
+  rsTrim(&E.rows, E.maxResident);
+}
+
+// --max-resident: index a page of KILO_PAGE_ROWS rows at a time, only where it starts and how long it is are kept.
+// The pages of the mapping the scan read are dropped right after, the rows of a page read them again when needed
+static void editorIndexPages(int upto, size_t budget) {
+  size_t offs[KILO_INDEX_BATCH];
+  size_t pos = E.indexed, from = pos;
+  size_t stop = budget < E.mapsize - pos ? pos + budget : E.mapsize;
+  while (pos < stop && E.numrows <= upto) {
+    size_t page = pos;
+    int n = 0;
+    while (n < KILO_PAGE_ROWS && pos < E.mapsize) {
+      size_t want = KILO_PAGE_ROWS - n < KILO_INDEX_BATCH ? KILO_PAGE_ROWS - n : KILO_INDEX_BATCH;
+      size_t got = lineIndexScan(E.map + pos, E.mapsize - pos, offs, want);
+      if (got == 0) {
+        // the last line has no newline at the end
+        pos = E.mapsize;
+        n++;
+        break;
+      }
+      pos += offs[got - 1] + 1;
+      n += got;
+    }
+    rsAppendPage(&E.rows, E.map + page, pos - page, n);
+    E.numrows += n;
+  }
+  editorPageDrop(E.map + from, pos - from);
+  E.indexed = pos;
+}
+
+// split more of the mapped file into rows, until row upto exists, about budget bytes were scanned, or the end of the file
+// the newlines are found a batch at a time by the vectorized scanner in lineindex.c
+void editorIndexRows(int upto, size_t budget) {
+  if (E.maxResident && !E.mapheap) {
+    editorIndexPages(upto, budget);
+    return;
+  }
+  // when every remaining row is wanted and we have several threads, let the workers in loader.c do it
+  if (E.threads > 1 && upto == INT_MAX) {
+    editorIndexParallel(budget);
+    return;
+  }
+  size_t offs[KILO_INDEX_BATCH];
+  size_t pos = E.indexed;
+  size_t stop = budget < E.mapsize - pos ? pos + budget : E.mapsize;
+  while (pos < stop && E.numrows <= upto) {
+    size_t want = (size_t)upto - E.numrows + 1;
+    if (want > KILO_INDEX_BATCH) want = KILO_INDEX_BATCH;
+    size_t base = pos;
+    size_t n = lineIndexScan(E.map + base, E.mapsize - base, offs, want);
+    if (n == 0) {
+      // the last line has no newline at the end
+      editorAppendMappedRow(E.map + pos, E.mapsize - pos);
+      pos = E.mapsize;
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      size_t eol = base + offs[i];
+      editorAppendMappedRow(E.map + pos, eol - pos);
+      pos = eol + 1;
+    }
+  }
+  E.indexed = pos;
+}
+
+// make sure row upto exists, unless the file has fewer rows
+void editorIndexTo(int upto) {
+  if (E.indexed < E.mapsize) editorIndexRows(upto, SIZE_MAX);
+}
+
+// index the mapped file step by step until a key arrives, then repaint so the status bar shows the new line count
+void editorIndexInBackground() {
+  if (E.indexed >= E.mapsize) return;
+  while (E.indexed < E.mapsize && !editorInputPending())
+    editorIndexRows(INT_MAX, (size_t)KILO_INDEX_STEP * E.threads);
+  editorRefreshScreen();
+}
+
+// give a row that still points into the mapped file its own null-terminated copy, so it can be edited
+void editorRowMaterialize(erow *row) {
+  if (!(row->flags & ROW_MAPPED)) return;
+  char *chars = arenaRealloc(&E.arena, NULL, &row->cap, row->size + 1);
+  memcpy(chars, row->chars, row->size);
+  chars[row->size] = '\0';
+  row->chars = chars;
+  row->flags &= ~ROW_MAPPED;
+  row->flags |= ROW_DIRTY; // a render shared with the old chars must not be used anymore
+}
+
+// arena blocks the live rows gave up to a snapshot, freed when it is released
+static struct {
+  void **blocks;
+  size_t *sizes;
+  int n, cap;
+} unshared;
+
+static void editorKeepUnshared(void *p, size_t size) {
+  if (unshared.n == unshared.cap) {
+    unshared.cap = unshared.cap ? unshared.cap * 2 : 256;
+    unshared.blocks = realloc(unshared.blocks, sizeof(void *) * unshared.cap);
+    unshared.sizes = realloc(unshared.sizes, sizeof(size_t) * unshared.cap);
+    if (unshared.blocks == NULL || unshared.sizes == NULL) die("realloc");
+  }
+  unshared.blocks[unshared.n] = p;
+  unshared.sizes[unshared.n++] = size;
+}
+
+// the row was just copied out of a snapshot of the row store (see rsSnapshot()), so its text and its ext are
+// still the snapshot's: give the row copies of its own, the snapshot keeps the old blocks untouched
+// the render is not copied, a snapshot never reads it
+void editorRowUnshare(erow *row) {
+  if (row->ext) {
+    size_t size = sizeof(struct rowExt) + sizeof(int) * row->ext->cap;
+    struct rowExt *ext = arenaAlloc(&E.arena, size);
+    memcpy(ext, row->ext, size);
+    editorKeepUnshared(row->ext, size);
+    row->ext = ext;
+  }
+  if (!(row->flags & ROW_MAPPED)) {
+    char *chars = arenaAlloc(&E.arena, row->cap);
+    memcpy(chars, row->chars, row->cap);
+    editorKeepUnshared(row->chars, row->cap);
+    row->chars = chars;
+    row->flags |= ROW_DIRTY; // a render shared with the old chars must not be used anymore
+  }
+}
+
+// the snapshot is gone, free the blocks only it was using
+void editorFreeUnshared() {
+  for (int i = 0; i < unshared.n; i++) arenaFree(&E.arena, unshared.blocks[i], unshared.sizes[i]);
+  free(unshared.blocks);
+  free(unshared.sizes);
+  memset(&unshared, 0, sizeof(unshared));
+}
+
 int getCursorPosition(int *rows, int *cols) {
   char buf[32];
   unsigned int i = 0;
   if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4) return -1;
+  struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
   while (i < sizeof(buf) - 1) {
-    if (read(STDIN_FILENO, &buf[i], 1) != 1) break;
+    if (poll(&pfd, 1, 1000) != 1 || read(STDIN_FILENO, &buf[i], 1) != 1) break;
     if (buf[i] == 'R') break;
     i++;
   }
@@ -209,9 +422,11 @@ int getWindowSize(int *rows, int *cols){
 
 /*** input ***/
 void editorScroll(){//This function is used to scroll the text in the editor.
+  // the rows on screen and the one below the cursor must be indexed before we draw them
+  editorIndexTo(E.cy + 1 > E.rowoff + E.screenrows ? E.cy + 1 : E.rowoff + E.screenrows);
   E.rx = 0;
   if (E.cy < E.numrows) {
-    E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
+    E.rx = editorRowCxToRx(rsAt(&E.rows, E.cy), E.cx);
   }
   //check if the cursor move above the visible area
   if(E.cy < E.rowoff){
@@ -222,11 +437,11 @@ void editorScroll(){//This function is used to scroll the text in the editor.
     E.rowoff = E.cy - E.screenrows + 1;
   }
   //check if the cursor move to the left of the visible area
-  if (E.cx < E.coloff) {
+  if (E.rx < E.coloff) {
     E.coloff = E.rx;
   }
   //check if the cursor move to the right of the visible area
-  if (E.cx >= E.coloff + E.screencols) {
+  if (E.rx >= E.coloff + E.screencols) {
     E.coloff = E.rx - E.screencols + 1;
   }
 }
@@ -234,7 +449,7 @@ void editorScroll(){//This function is used to scroll the text in the editor.
 //controlling the movement of the curs  or, this allow to use keyboard to move the cursor
 // Function to handle cursor movement based on arrow key input
 void editorMoveCursor(int key) {
-  erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  erow *row = (E.cy >= E.numrows) ? NULL : rsAt(&E.rows, E.cy);
   switch (key) {
     case ARROW_LEFT:
       // Move cursor left if it's not at the leftmost position
@@ -244,7 +459,7 @@ void editorMoveCursor(int key) {
         // Move to the end of the previous line if we're not on the first line
         E.cy--;
         // Set the cursor to the end of the previous line
-        E.cx = E.row[E.cy].size;
+        E.cx = rsAt(&E.rows, E.cy)->size;
       }
       break;
       //allow the user to scrool pass the right edge of the screen
@@ -265,13 +480,14 @@ void editorMoveCursor(int key) {
       break;
     case ARROW_DOWN:
       // Move cursor down if it's not at the bottom of the file
+      editorIndexTo(E.cy + 1);
       if (E.cy != E.numrows){
         E.cy++;
       }
       break;
   }
   // Get a pointer to the current row, or NULL if we're past the end of the file
-  row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy];
+  row = (E.cy >= E.numrows) ? NULL : rsAt(&E.rows, E.cy);
 
   // Determine the length of the current row
   // If we're on a valid row, use its size; otherwise, use 0
@@ -294,12 +510,14 @@ void editorProcessKeyPress() {
       editorInsertNewline();
       break;
     case CTRL_KEY('q'):// default operation for the text editor, use ctrl-q to quit
+      editorSaveWait(); // a save still being written finishes first, it may leave the file clean
       if (E.dirty && quit_times > 0) {
         editorSetStatusMessage("WARNING!!! File has unsaved changes. "
           "Press Ctrl-Q %d more times to quit.", quit_times);
         quit_times--;
         return;
       }
+      editorJournalClose(1); // the edits were saved or given up, the journal is not needed
       write(STDOUT_FILENO, "\x1b[2J", 4);
       write(STDOUT_FILENO, "\x1b[H", 3);
       exit(0);
@@ -318,7 +536,13 @@ void editorProcessKeyPress() {
     //go to the end of the line
     case END_KEY:
       if (E.cy < E.numrows)
-        E.cx = E.row[E.cy].size;
+        E.cx = rsAt(&E.rows, E.cy)->size;
+      break;
+    case CTRL_KEY('z'):
+      editorUndo();
+      break;
+    case CTRL_KEY('y'):
+      editorRedo();
       break;
     case CTRL_KEY('f'):
       editorFind();
@@ -338,6 +562,7 @@ void editorProcessKeyPress() {
       if (c == PAGE_UP) {
         E.cy = E.rowoff;
       }else if (c == PAGE_DOWN) {
+        editorIndexTo(E.rowoff + 2 * E.screenrows);
         E.cy = E.rowoff + E.screenrows - 1;
         if(E.cy > E.numrows) E.cy = E.numrows;
       }
@@ -356,6 +581,20 @@ void editorProcessKeyPress() {
       editorMoveCursor(c);
       break;
     case CTRL_KEY('l'):
+      editorInvalidateScreen();
+      break;
+    case CTRL_KEY('t'):
+      editorShowStats();
+      break;
+    case PASTE_EVENT:
+      editorInsertText(E.paste.b, E.paste.len);
+      break;
+    case WAKE_EVENT:
+      // the background save made progress or is done, or the followed file grew,
+      // any other worker's results nobody waits for any more
+      editorSavePoll();
+      editorFollowPoll();
+      break;
     case '\x1b':
       break;
     default:
@@ -366,45 +605,215 @@ void editorProcessKeyPress() {
   
 }
 void editorInsertNewline() {
+  editorJournal(JOURNAL_NEWLINE, E.cy, E.cx, NULL, 0);
+  // on the line past the end Enter only adds an empty row, anywhere else it inserts a row boundary
+  if (E.cy == E.numrows) editorRecordEdit(UNDO_INSERT, E.cy, 0, "", 0, 1);
+  else editorRecordEdit(UNDO_INSERT, E.cy, E.cx, "\n", 1, 1);
   if (E.cx == 0) {
     editorInsertRow(E.cy, "", 0);
   } else {
-    erow *row = &E.row[E.cy];
+    erow *row = rsAt(&E.rows, E.cy);
+    editorRowCloseGap(row);
     editorInsertRow(E.cy + 1, &row->chars[E.cx], row->size - E.cx);
-    row = &E.row[E.cy];
+    row = rsAt(&E.rows, E.cy);
+    editorRowMaterialize(row);
     row->size = E.cx;
     row->chars[row->size] = '\0';
-    editorUpdateRow(row);
+    editorRowChanged(row, E.cx);
   }
   E.cy++;
   E.cx = 0;
 }
 
+// length of the line starting at s, and in *next where the line after it starts; \r\n, \r and \n all end a line
+static int editorLineLen(const char *s, int len, int *next) {
+  int i = 0;
+  while (i < len && s[i] != '\r' && s[i] != '\n') i++;
+  *next = i;
+  if (i < len) *next += (s[i] == '\r' && i + 1 < len && s[i + 1] == '\n') ? 2 : 1;
+  return i;
+}
+
+// insert a block of text at the cursor in one operation, this is how a paste gets in
+// newlines in the text split the row like Enter, the new rows go into the row store with one bulk insert
+// and nothing is rendered here, rows are rendered when they are drawn
+void editorInsertText(const char *s, int len) {
+  if (len <= 0) return;
+  editorJournal(JOURNAL_INSERT, E.cy, E.cx, s, len);
+  editorRecordEdit(UNDO_INSERT, E.cy, E.cx, s, len, 0);
+  if (E.cy == E.numrows) editorInsertRow(E.numrows, "", 0);
+  erow *row = rsAt(&E.rows, E.cy);
+  editorRowMaterialize(row);
+  editorRowCloseGap(row);
+  int at = E.cx;
+
+  int lines = 0;
+  for (int i = 0; i < len; i++)
+    if (s[i] == '\n' || (s[i] == '\r' && !(i + 1 < len && s[i + 1] == '\n'))) lines++;
+
+  int next;
+  int first = editorLineLen(s, len, &next);
+  if (lines == 0) {
+    row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, row->size + len + 1);
+    memmove(&row->chars[E.cx + len], &row->chars[E.cx], row->size - E.cx + 1);
+    memcpy(&row->chars[E.cx], s, len);
+    row->size += len;
+    E.cx += len;
+  } else {
+    // build the new rows first, the last one takes the part of the current row after the cursor
+    erow *rows = malloc(sizeof(erow) * lines);
+    if (rows == NULL) die("malloc");
+    char *tail = &row->chars[E.cx];
+    int tailLen = row->size - E.cx;
+    int pos = next, last = 0;
+    for (int i = 0; i < lines; i++) {
+      int n = editorLineLen(s + pos, len - pos, &next);
+      int size = n + (i == lines - 1 ? tailLen : 0);
+      rows[i].cap = arenaBlockSize(size + 1);
+      rows[i].chars = arenaAlloc(&E.arena, rows[i].cap);
+      memcpy(rows[i].chars, s + pos, n);
+      memcpy(rows[i].chars + n, tail, size - n);
+      rows[i].chars[size] = '\0';
+      rows[i].size = size;
+      rows[i].rsize = 0;
+      rows[i].render = NULL;
+      rows[i].flags = 0;
+      rows[i].ext = NULL;
+      last = n;
+      pos += next;
+    }
+    // the current row keeps what is before the cursor plus the first line of the text
+    row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, E.cx + first + 1);
+    memcpy(&row->chars[E.cx], s, first);
+    row->size = E.cx + first;
+    row->chars[row->size] = '\0';
+    rsInsertRows(&E.rows, E.cy + 1, rows, lines);
+    free(rows);
+    row = rsAt(&E.rows, E.cy);
+    E.numrows += lines;
+    E.cy += lines;
+    E.cx = last;
+  }
+  editorRowChanged(row, at);
+  E.dirty++;
+}
+
+// delete len bytes of text starting at row cy, column cx, every row boundary counts as one byte ('\n')
+// the rows removed whole go out with one rsDeleteRows() call, so this is O(len) however many rows it spans
+void editorDeleteText(int cy, int cx, int len) {
+  if (len <= 0 || cy < 0 || cy >= E.numrows) return;
+  editorJournal(JOURNAL_DELETE, cy, cx, NULL, len);
+  // find the row and column where the deleted text ends
+  int r = cy, c = cx, left = len;
+  erow *row = rsAt(&E.rows, r);
+  while (left > row->size - c && r + 1 < E.numrows) {
+    left -= row->size - c + 1;
+    r++;
+    c = 0;
+    row = rsAt(&E.rows, r);
+  }
+  if (left > row->size - c) left = row->size - c;
+  c += left;
+
+  erow *first = rsAt(&E.rows, cy);
+  editorRowMaterialize(first);
+  editorRowCloseGap(first);
+  if (r == cy) {
+    memmove(&first->chars[cx], &first->chars[c], first->size - c + 1);
+    first->size -= c - cx;
+  } else {
+    // the first row keeps what is before cx and takes what is after c on the last row
+    erow *last = rsAt(&E.rows, r);
+    editorRowCloseGap(last);
+    int tail = last->size - c;
+    first = rsAt(&E.rows, cy);
+    first->chars = arenaRealloc(&E.arena, first->chars, &first->cap, cx + tail + 1);
+    memcpy(&first->chars[cx], &last->chars[c], tail);
+    first->size = cx + tail;
+    first->chars[first->size] = '\0';
+    for (int j = cy + 1; j <= r; j++) editorFreeRow(rsAt(&E.rows, j));
+    rsDeleteRows(&E.rows, cy + 1, r - cy);
+    E.numrows -= r - cy;
+    first = rsAt(&E.rows, cy);
+  }
+  editorRowChanged(first, cx);
+  E.dirty++;
+}
+
+// replace the spans, sorted by row and column and not overlapping, in one pass over the rows they are in:
+// every row is rebuilt once however many spans it has, into a block of exactly its new size. The text of
+// the spans holds no line ending, the rows stay the rows. This is how replace-all gets in, and out again on undo
+void editorReplaceSpans(struct replaceSpan *spans, int n) {
+  editorJournalSpans(spans, n);
+  for (int i = 0; i < n;) {
+    int j = i + 1;
+    while (j < n && spans[j].row == spans[i].row) j++;
+    erow *row = rsAt(&E.rows, spans[i].row);
+    editorRowCloseGap(row);
+    int size = row->size;
+    for (int k = i; k < j; k++) size += spans[k].tlen - spans[k].len;
+    int cap = arenaBlockSize(size + 1);
+    char *chars = arenaAlloc(&E.arena, cap);
+    int from = 0, to = 0;
+    for (int k = i; k < j; k++) {
+      memcpy(&chars[to], &row->chars[from], spans[k].col - from);
+      to += spans[k].col - from;
+      memcpy(&chars[to], spans[k].text, spans[k].tlen);
+      to += spans[k].tlen;
+      from = spans[k].col + spans[k].len;
+    }
+    memcpy(&chars[to], &row->chars[from], row->size - from);
+    chars[size] = '\0';
+    // a row from the mapped file gets its own copy here, without copying the old text first
+    if (!(row->flags & ROW_MAPPED)) arenaFree(&E.arena, row->chars, row->cap);
+    row->flags &= ~ROW_MAPPED;
+    row->chars = chars;
+    row->cap = cap;
+    row->size = size;
+    editorRowChanged(row, spans[i].col);
+    E.dirty++;
+    i = j;
+  }
+}
+
 /*** output ***/
 //https://vt100.net/docs/vt100-ug/chapter3.html#CUP
 
 void editorRowInsertChar(erow *row, int at, int c) {
   if(at < 0 || at > row->size) return; // Check for invalid insertion position
-  row->chars = realloc(row->chars, row->size + 2); // Reallocate memory for new character
+  editorRowMaterialize(row); // a row from the mapped file needs its own copy before we change it
+  if (row->size >= KILO_GAP_MIN) {
+    // a long row moves its gap to the cursor and types into it, nothing after the cursor moves
+    editorRowMoveGap(row, at);
+    row->chars[at] = c;
+    row->ext->gapStart++;
+    row->ext->gapLen--;
+    row->size++;
+    editorRowChanged(row, at);
+    E.dirty++;
+    return;
+  }
+  editorRowCloseGap(row);
+  row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, row->size + 2); // make room for the new character, free while it fits the block
   memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1); // Shift characters to make space
   row->size++; // Increase the row size
   row->chars[at] = c; // Insert the new character
-  editorUpdateRow(row); // Update the rendered version of the row
+  editorRowChanged(row, at); // Update the rendered version of the row
   E.dirty++;
 }
 
 void editorRowAppendString(erow *row, char *s, size_t len) {
-  row->chars = realloc(row->chars, row->size + len + 1);
+  editorRowMaterialize(row);
+  editorRowCloseGap(row);
+  row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, row->size + len + 1);
   memcpy(&row->chars[row->size], s, len);
+  editorRowChanged(row, row->size);
   row->size += len;
   row->chars[row->size] = '\0';
-  editorUpdateRow(row);
   E.dirty++;
 }
 
 void editorDrawMessageBar(struct abuf *ab) {
-  // Clear the message bar with escape sequence
-  abAppend(ab, "\x1b[K", 3);
   // Get the length of the current status message
   int msglen = strlen(E.statusmsg);
   // Truncate message if it's longer than the screen width
@@ -415,39 +824,234 @@ void editorDrawMessageBar(struct abuf *ab) {
 }
 
 
+/*
+The screen is drawn into a back buffer that holds one line per screen row, then compared with the front buffer,
+the frame the terminal is showing right now. Only the lines that changed are sent, and on plain text lines
+only the part between the first and the last changed column. Over a slow link a keystroke costs a few bytes
+instead of the whole screen. Ctrl-L throws the front buffer away and repaints everything.
+*/
 void editorRefreshScreen(){
+  // between frames nothing holds a row, pages of a big file that were not looked at for a while can go
+  editorPageTrim();
   // Handle scrolling if the cursor has moved out of the visible area
   editorScroll();
 
-  // Initialize an append buffer to store the screen update commands
-  struct abuf ab = ABUF_INIT; // init an append buffer
+  // text rows, status bar and message bar
+  int nlines = E.screenrows + 2;
+  if (E.front == NULL || E.screenlines != nlines) editorResizeScreen(nlines);
+  long allocs = abAllocs;
+  for (int y = 0; y < nlines; y++) abReset(&E.back[y]);
 
-  // Hide the cursor while updating the screen
-  abAppend(&ab,"\x1b[?25l",6);
+  // Draw the rows of the editor (text content or welcome message)
+  editorDrawRows(E.back);
+  editorDrawStatusBar(&E.back[E.screenrows]);
+  editorDrawMessageBar(&E.back[E.screenrows + 1]);
+
+  // the buffer for the screen update commands lives as long as the editor, after the first frames it never grows
+  struct abuf *ab = &E.out;
+  abReset(ab);
+  if (E.fullRedraw) {
+    // the terminal is cleared, so the previous frame counts as blank lines
+    abAppend(ab, "\x1b[2J", 4);
+    for (int y = 0; y < nlines; y++) abReset(&E.front[y]);
+    E.termRow = E.termCol = E.termAttr = -1;
+    E.fullRedraw = 0;
+  }
+  int hidden = 0;
+  for (int y = 0; y < nlines; y++) {
+    struct abuf *old = &E.front[y], *new = &E.back[y];
+    if (old->len == new->len && (new->len == 0 || memcmp(old->b, new->b, new->len) == 0)) continue;
+    if (!hidden) {
+      // Hide the cursor while updating the screen
+      abAppend(ab, "\x1b[?25l", 6);
+      hidden = 1;
+    }
+    editorDrawLineDiff(ab, y, old, new);
+  }
 
-  // Move the cursor to the top-left corner of the screen
-  // Note: "\x1b[2J" (clear entire screen) is commented out to avoid flickering
-  abAppend(&ab, "\x1b[H", 3);
+  // leave the terminal with normal colors, then move the cursor to its position in the editor
+  editorSetAttr(ab, 0);
+  editorMoveTo(ab, E.cy - E.rowoff, E.rx - E.coloff);
 
-  // Draw the rows of the editor (text content or welcome message)
-  editorDrawRows(&ab);
-  editorDrawStatusBar(&ab); 
-  editorDrawMessageBar(&ab);
+  // Show the cursor again
+  if (hidden) abAppend(ab, "\x1b[?25h", 6);
+
+  // Write only what changed to the terminal in one go, nothing at all when the frame is the same
+  if (ab->len) write(STDOUT_FILENO, ab->b, ab->len);
+  E.frameBytes = ab->len;
+  E.totalFrameBytes += ab->len;
+  E.frames++;
+  E.lastFrameTime = editorNow();
+  if (E.frameKeys) {
+    // time from the arrival of the oldest key to its frame hitting the terminal
+    E.lastLatency = E.lastFrameTime - E.inputTime;
+    if (E.lastLatency > E.maxLatency) E.maxLatency = E.lastLatency;
+    E.totalLatency += E.lastLatency;
+    E.latencyFrames++;
+    E.skippedFrames += E.frameKeys - 1;
+    E.frameKeys = 0;
+    E.inputTime = editorInputPending() ? E.lastFrameTime : 0;
+  }
+
+  // the frame we just drew becomes the one to compare against next time
+  struct abuf *t = E.front;
+  E.front = E.back;
+  E.back = t;
+
+  E.frameAllocs = abAllocs - allocs;
+}
+
+// allocate the front and back screen buffers for nlines lines, the next frame is a full repaint
+void editorResizeScreen(int nlines) {
+  for (int y = 0; E.front && y < E.screenlines; y++) {
+    abFree(&E.front[y]);
+    abFree(&E.back[y]);
+  }
+  free(E.front);
+  free(E.back);
+  E.front = calloc(nlines, sizeof(struct abuf));
+  E.back = calloc(nlines, sizeof(struct abuf));
+  if (E.front == NULL || E.back == NULL) die("calloc");
+  E.screenlines = nlines;
+  E.fullRedraw = 1;
+}
+
+// split a screen line into cells, one character and its attribute (1 = inverted) per column
+// returns the number of cells, or -1 if the line holds anything but printable ascii and our own color escapes
+static int editorLineCells(struct abuf *line, char *ch, char *attr, int max) {
+  int n = 0, a = 0;
+  for (int i = 0; i < line->len; i++) {
+    char c = line->b[i];
+    if (c == '\x1b') {
+      if (i + 3 < line->len && memcmp(&line->b[i], "\x1b[7m", 4) == 0) {
+        a = 1;
+        i += 3;
+      } else if (i + 2 < line->len && memcmp(&line->b[i], "\x1b[m", 3) == 0) {
+        a = 0;
+        i += 2;
+      } else {
+        return -1;
+      }
+    } else if (c >= 0x20 && c <= 0x7e && n < max) {
+      ch[n] = c;
+      attr[n++] = a;
+    } else {
+      return -1;
+    }
+  }
+  return n;
+}
+
+// switch the terminal to attribute a (1 = inverted) if it isn't already
+void editorSetAttr(struct abuf *ab, int a) {
+  if (E.termAttr == a) return;
+  if (a) abAppend(ab, "\x1b[7m", 4);
+  else abAppend(ab, "\x1b[m", 3);
+  E.termAttr = a;
+}
+
+// send the difference between the old and the new contents of screen line y
+void editorDrawLineDiff(struct abuf *ab, int y, struct abuf *old, struct abuf *new) {
+  int max = E.screencols;
+  char och[max + 1], oattr[max + 1], nch[max + 1], nattr[max + 1];
+  int on = editorLineCells(old, och, oattr, max);
+  int nn = editorLineCells(new, nch, nattr, max);
+
+  if (on < 0 || nn < 0) {
+    // wide characters or unknown escapes, we can't tell the columns apart so rewrite the whole line
+    editorMoveTo(ab, y, 0);
+    editorSetAttr(ab, 0);
+    if (old->len) abAppend(ab, "\x1b[K", 3);
+    abAppend(ab, new->b, new->len);
+    E.termCol = E.termAttr = -1;
+    return;
+  }
 
-  // Move the cursor to its current position in the editor
+  // skip the cells that didn't change at the start, and at the end when the line kept its length
+  int start = 0, end = nn;
+  int common = on < nn ? on : nn;
+  while (start < common && och[start] == nch[start] && oattr[start] == nattr[start]) start++;
+  if (on == nn) {
+    while (end > start && och[end - 1] == nch[end - 1] && oattr[end - 1] == nattr[end - 1]) end--;
+  }
+  editorMoveTo(ab, y, start);
+  if (nn < on) {
+    // clear before writing, a \x1b[K right after the last column would erase the character there
+    editorSetAttr(ab, 0);
+    abAppend(ab, "\x1b[K", 3);
+  }
+  for (int i = start; i < end; i++) {
+    editorSetAttr(ab, nattr[i]);
+    abAppend(ab, &nch[i], 1);
+  }
+  // after writing the last column the terminal cursor waits to wrap, don't rely on its position
+  E.termCol = end < E.screencols ? end : -1;
+}
+
+// move the terminal cursor to screen line y, column x with the shortest sequence we know works
+void editorMoveTo(struct abuf *ab, int y, int x) {
+  if (E.termRow == y && E.termCol == x) return;
   char buf[32];
-  // Calculate the actual screen position, accounting for scrolling offsets
-  snprintf(buf, sizeof(buf), "\x1b[%d;%dH", (E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1);
-  abAppend(&ab, buf, strlen(buf));
+  int len;
+  if (x == 0 && E.termRow == y) {
+    len = snprintf(buf, sizeof(buf), "\r");
+  } else if (x == 0 && E.termRow >= 0 && E.termRow == y - 1) {
+    len = snprintf(buf, sizeof(buf), "\r\n");
+  } else if (E.termRow == y && E.termCol >= 0 && x > E.termCol) {
+    len = snprintf(buf, sizeof(buf), "\x1b[%dC", x - E.termCol);
+  } else {
+    len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", y + 1, x + 1);
+  }
+  abAppend(ab, buf, len);
+  E.termRow = y;
+  E.termCol = x;
+}
 
-  // Show the cursor again
-  abAppend(&ab, "\x1b[?25h", 6); 
+// Ctrl-L: forget what the terminal shows and repaint the whole screen on the next frame
+void editorInvalidateScreen() {
+  E.fullRedraw = 1;
+}
 
-  // Write the entire buffer to the terminal in one go
-  write(STDOUT_FILENO, ab.b, ab.len);
+// rsEach visitor: add up the bytes of the arena the rows hold
+static int editorArenaLive(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  size_t *live = arg;
+  for (int i = 0; i < n; i++) {
+    if (!(rows[i].flags & ROW_MAPPED)) *live += rows[i].size + 1;
+    if (rows[i].render && !(rows[i].flags & ROW_SHARED)) *live += rows[i].rsize + 1;
+  }
+  return 1;
+}
 
-  // Free the memory used by the append buffer
-  abFree(&ab);
+// Ctrl-T: show statistics about the editor in the message bar
+// every Ctrl-T shows the next page of stats
+void editorShowStats() {
+  static int page = 0;
+  switch (page++ % (E.maxResident ? 4 : 3)) {
+    case 0:
+      editorSetStatusMessage("frame: %d bytes, %d allocs | avg %.1f bytes/frame over %ld frames",
+        E.frameBytes, E.frameAllocs, E.frames ? (double)E.totalFrameBytes / E.frames : 0.0, E.frames);
+      break;
+    case 1:
+      editorSetStatusMessage("input to paint: %.2fms, avg %.2fms, max %.2fms | %ld frames skipped",
+        E.lastLatency / 1000.0, E.latencyFrames ? E.totalLatency / 1000.0 / E.latencyFrames : 0.0,
+        E.maxLatency / 1000.0, E.skippedFrames);
+      break;
+    case 2: {
+      // wasted is everything taken from malloc that holds no text: size class rounding, free lists, chunk ends
+      // walked with rsEach(), looking up every row would page in all of a paged file
+      size_t live = 0;
+      rsEach(&E.rows, 0, editorArenaLive, &live);
+      size_t reserved = arenaReserved(&E.arena);
+      editorSetStatusMessage("arena: %zu KB used, %zu KB wasted, %d chunks",
+        live / 1024, (reserved - live) / 1024, E.arena.nchunks);
+      break;
+    }
+    case 3:
+      editorSetStatusMessage("pages: %zu MB in of %zu MB allowed, %d rows in pages of %d",
+        E.rows.resident >> 20, E.maxResident >> 20, E.numrows, KILO_PAGE_ROWS);
+      break;
+  }
 }
 
 //varidaric function can take variable number of arguments
@@ -467,9 +1071,10 @@ void editorDrawStatusBar(struct abuf *ab) {
   char status[80], rstatus[80];
   // Format the left side of the status bar with filename and number of lines
   // Limit filename to 20 characters, use "[No Name]" if no filename is set
-  int len = snprintf(status, sizeof(status), "%.20s - %d lines %s",
+  // a + after the line count means the file is still being indexed
+  int len = snprintf(status, sizeof(status), "%.20s - %d%s lines %s",
     E.filename ? E.filename : "[No Name]", E.numrows,
-    E.dirty ? "(modified)" : "");
+    E.indexed < E.mapsize ? "+" : "", E.dirty ? "(modified)" : "");
   // Format the right side of the status bar with current line/total lines
   int rlen = snprintf(rstatus, sizeof(rstatus), "%d/%d",
     E.cy + 1, E.numrows);
@@ -477,57 +1082,214 @@ void editorDrawStatusBar(struct abuf *ab) {
   if (len > E.screencols) len = E.screencols;
   // Append the left status to the buffer
   abAppend(ab, status, len);
-  // Fill the remaining space with either spaces or the right status
-  while (len < E.screencols) {
-    // If there's exactly enough space left for the right status
-    if (E.screencols - len == rlen) {
-      // Append the right status
-      abAppend(ab, rstatus, rlen);
-      break;
-    } else {
-      // Otherwise, append a space and increment the length
-      abAppend(ab, " ", 1);
-      len++;
-    }
+  // Fill the remaining space with spaces, then the right status if it fits
+  if (E.screencols - len >= rlen) {
+    abFill(ab, ' ', E.screencols - len - rlen);
+    abAppend(ab, rstatus, rlen);
+  } else {
+    abFill(ab, ' ', E.screencols - len);
   }
 
   // Reset the terminal colors back to normal
   abAppend(ab, "\x1b[m", 3);
-  abAppend(ab, "\r\n", 2);
+}
+
+/*
+Long rows (KILO_GAP_MIN bytes or more) are edited as a gap buffer: the free space of the block is kept
+as a gap at the cursor, typing fills the gap and deleting widens it, so a key costs O(1) instead of moving
+the whole rest of the row. The gap is described by row->ext, byte i of the text is at chars[i] before
+the gap and at chars[i + gapLen] after it. Code that wants the text in one piece (save, search, joining
+rows) calls editorRowCloseGap() first, drawing and the cx/rx conversions read through the gap.
+*/
+
+// byte i of the text of a row, wherever the gap is
+char editorRowByte(erow *row, int i) {
+  struct rowExt *ext = row->ext;
+  return row->chars[ext && i >= ext->gapStart ? i + ext->gapLen : i];
+}
+
+// bytes [start, start + len) of a row in one piece, copied into tmp if the gap is in the way
+const char *editorRowSegment(erow *row, int start, int len, char *tmp) {
+  struct rowExt *ext = row->ext;
+  if (ext == NULL || ext->gapLen == 0 || start + len <= ext->gapStart) return &row->chars[start];
+  if (start >= ext->gapStart) return &row->chars[start + ext->gapLen];
+  int before = ext->gapStart - start;
+  memcpy(tmp, &row->chars[start], before);
+  memcpy(tmp + before, &row->chars[ext->gapStart + ext->gapLen], len - before);
+  return tmp;
+}
+
+// make the text of a row contiguous again by moving its gap to the end
+void editorRowCloseGap(erow *row) {
+  struct rowExt *ext = row->ext;
+  if (ext == NULL || ext->gapLen == 0) return;
+  memmove(&row->chars[ext->gapStart], &row->chars[ext->gapStart + ext->gapLen], row->size - ext->gapStart);
+  ext->gapLen = 0;
+  row->chars[row->size] = '\0';
+}
+
+// move the gap of a long row to byte at, opening a new one when the row has none or it is used up
+void editorRowMoveGap(erow *row, int at) {
+  editorRowIndex(row, 0); // makes sure the row has its ext
+  struct rowExt *ext = row->ext;
+  if (ext->gapLen == 0) {
+    // the text is contiguous, the free end of the block becomes the gap, after growing the block if it is short
+    int want = row->size / 8 > KILO_GAP ? row->size / 8 : KILO_GAP;
+    if (row->cap - row->size - 1 < want)
+      row->chars = arenaRealloc(&E.arena, row->chars, &row->cap, (size_t)row->size + 1 + want);
+    ext->gapStart = row->size;
+    ext->gapLen = row->cap - row->size - 1; // one byte stays free for the null terminator of editorRowCloseGap()
+  }
+  if (at < ext->gapStart)
+    memmove(&row->chars[at + ext->gapLen], &row->chars[at], ext->gapStart - at);
+  else if (at > ext->gapStart)
+    memmove(&row->chars[ext->gapStart], &row->chars[ext->gapStart + ext->gapLen], at - ext->gapStart);
+  ext->gapStart = at;
+}
+
+// draw the visible part of a long row straight from its text, with the same tab and control character rules as editorRenderRow()
+void editorDrawLongRow(struct abuf *ab, erow *row) {
+  int cx = editorRowRxToCx(row, E.coloff);
+  int rx = editorRowCxToRx(row, cx);
+  int col = 0; // screen column
+  while (cx < row->size && col < E.screencols) {
+    char c = editorRowByte(row, cx++);
+    if (c == '\t') {
+      // a tab that starts left of the screen only shows its columns from coloff on
+      int next = (rx / KILO_TAB_STOP + 1) * KILO_TAB_STOP;
+      int from = rx < E.coloff ? E.coloff : rx;
+      int n = next - from;
+      if (n > E.screencols - col) n = E.screencols - col;
+      abFill(ab, ' ', n);
+      col += n;
+      rx = next;
+    } else {
+      c = iscntrl((unsigned char)c) ? '?' : c;
+      abAppend(ab, &c, 1);
+      col++;
+      rx++;
+    }
+  }
 }
 
 // Function to convert cursor x position (cx) to render x position (rx)
 // This accounts for the presence of tab characters in the row
 int editorRowCxToRx(erow *row, int cx) {
   int rx = 0;  // Initialize render x position
+  int j = 0;
+  // a long row starts from the checkpoint at or before cx, so at most KILO_RX_STEP bytes are scanned
+  if (editorRowIndex(row, cx / KILO_RX_STEP)) {
+    rx = row->ext->rx[cx / KILO_RX_STEP];
+    j = cx / KILO_RX_STEP * KILO_RX_STEP;
+  }
   // Iterate through each character up to the cursor position
-  for(int j = 0; j < cx; j++) {
-    if(row->chars[j] == '\t') {
-      // If the character is a tab, adjust rx to the next tab stop
+  for(; j < cx; j++) {
+    if(editorRowByte(row, j) == '\t') {
+      // If the character is a tab, move rx to the column before the next tab stop
       rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
-    } else {
-      // For non-tab characters, simply increment rx
-      rx++;
     }
+    // every character, tabs included, then takes one more column
+    rx++;
   }
   // Return the final render x position
   return rx;
 }
 
 
-// Function to update the rendered version of a row
-void editorUpdateRow(erow *row){
-  int tabs = 0;
-  for(int j = 0; j < row->size; j++) {
-    if(row->chars[j] == '\t') {
-      tabs++; 
+/*
+Long rows keep an index of checkpoints in row->ext: rx[k] is the render column of byte k * KILO_RX_STEP.
+Converting between cx and rx then scans at most KILO_RX_STEP bytes from the nearest checkpoint instead of the whole row.
+The index is built lazily, only as far as a conversion needs it, and an edit at byte at only throws away
+the checkpoints after at, so typing at the end of a long row costs the same as typing at the start of a short one.
+*/
+
+// make sure the checkpoints of a long row are known up to checkpoint k (or the end of the row)
+// returns 0 for rows too short to be worth an index
+int editorRowIndex(erow *row, int k) {
+  if (row->size < KILO_RX_MIN) return 0;
+  int n = row->size / KILO_RX_STEP + 1; // checkpoints the row has
+  struct rowExt *ext = row->ext;
+  if (ext == NULL || ext->cap < n) {
+    // grow the index, the block size goes with the number of checkpoints so the arena can take it back
+    int cap = n + n / 2;
+    struct rowExt *bigger = arenaAlloc(&E.arena, sizeof(struct rowExt) + sizeof(int) * cap);
+    bigger->cap = cap;
+    bigger->valid = 0;
+    bigger->gapStart = bigger->gapLen = 0;
+    if (ext) {
+      bigger->valid = ext->valid;
+      bigger->gapStart = ext->gapStart;
+      bigger->gapLen = ext->gapLen;
+      memcpy(bigger->rx, ext->rx, sizeof(int) * ext->valid);
+      arenaFree(&E.arena, ext, sizeof(struct rowExt) + sizeof(int) * ext->cap);
+    }
+    row->ext = ext = bigger;
+  }
+  if (ext->valid > n) ext->valid = n; // the row got shorter
+  if (ext->valid == 0) ext->rx[ext->valid++] = 0;
+  if (k >= n) k = n - 1;
+  while (ext->valid <= k) {
+    int start = (ext->valid - 1) * KILO_RX_STEP;
+    int rx = ext->rx[ext->valid - 1];
+    char tmp[KILO_RX_STEP];
+    const char *seg = editorRowSegment(row, start, KILO_RX_STEP, tmp);
+    if (memchr(seg, '\t', KILO_RX_STEP) == NULL) {
+      rx += KILO_RX_STEP; // no tabs, every byte is one column
+    } else {
+      for (int j = 0; j < KILO_RX_STEP; j++) {
+        if (seg[j] == '\t') rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
+        rx++;
+      }
     }
+    ext->rx[ext->valid++] = rx;
   }
-  // Free the previously allocated memory for the rendered row
-  free(row->render);
-  // Allocate new memory for the rendered row
+  return 1;
+}
+
+// Function to record that the text of a row changed from byte at on
+// the render is rebuilt when the row is next drawn, and the rx checkpoints after at are recomputed when needed
+void editorRowChanged(erow *row, int at) {
+  row->flags |= ROW_DIRTY;
+  if (row->ext && row->ext->valid > at / KILO_RX_STEP + 1) row->ext->valid = at / KILO_RX_STEP + 1;
+}
+
+// Function to mark the rendered version of a row out of date, when the whole row may have changed
+void editorUpdateRow(erow *row){
+  editorRowChanged(row, 0);
+}
+
+// the rendered text of a row, rendered now if it is missing or out of date
+char *editorRowRender(erow *row) {
+  if (row->render == NULL || (row->flags & ROW_DIRTY)) editorRenderRow(row);
+  return row->render;
+}
+
+// release the render of a row, unless it is the row's own chars
+static void editorFreeRender(erow *row) {
+  if (!(row->flags & ROW_SHARED)) arenaFree(&E.arena, row->render, row->rsize + 1);
+  row->render = NULL;
+  row->flags &= ~ROW_SHARED;
+}
+
+// Function to build the rendered version of a row
+void editorRenderRow(erow *row) {
+  editorRowCloseGap(row);
+  editorFreeRender(row);
+  row->flags &= ~ROW_DIRTY;
+  // most rows have no tabs or control characters, they are drawn exactly as they are stored
+  int plain = 1;
+  for (int j = 0; j < row->size && plain; j++) {
+    if (iscntrl((unsigned char)row->chars[j])) plain = 0;
+  }
+  if (plain) {
+    row->render = row->chars;
+    row->rsize = row->size;
+    row->flags |= ROW_SHARED;
+    return;
+  }
+  // Allocate exactly the rendered length, the block is given back later by that size
   // +1 for the null terminator
-  row->render = malloc(row->size + tabs*(KILO_TAB_STOP - 1) + 1);
+  row->render = arenaAlloc(&E.arena, editorRowCxToRx(row, row->size) + 1);
   // Initialize index for the rendered row
   int idx = 0;
   // Loop through each character in the original row
@@ -536,6 +1298,9 @@ void editorUpdateRow(erow *row){
     if (row->chars[j] == '\t') {
       row->render[idx++] =' ';
       while (idx % KILO_TAB_STOP != 0) row->render[idx++] = ' ';
+    } else if (iscntrl((unsigned char)row->chars[j])) {
+      // other control characters would be taken as terminal commands, show them as '?'
+      row->render[idx++] = '?';
     }else{
     // Copy the character to the rendered row
     row->render[idx++] = row->chars[j];
@@ -544,76 +1309,27 @@ void editorUpdateRow(erow *row){
   // Null-terminate the rendered string
   row->render[idx] = '\0';
   // Update the size of the rendered row
-  row->size = idx;
+  row->rsize = idx;
 }
 // Function to free the memory allocated for a single row
 void editorFreeRow(erow *row) {
   // Free the memory allocated for the rendered version of the row
-  free(row->render);
-  // Free the memory allocated for the actual characters in the row
-  free(row->chars);
-}
-
-void editorFindCallback(char *query, int key) {
-  static int last_match = -1;
-  static int direction = 1;
-  if (key == '\r' || key == '\x1b') {
-    last_match = -1;
-    direction = 1;
-    return;
-  } else if (key == ARROW_RIGHT || key == ARROW_DOWN) {
-    direction = 1;
-  } else if (key == ARROW_LEFT || key == ARROW_UP) {
-    direction = -1;
-  } else {
-    last_match = -1;
-    direction = 1;
-  }
-  if (last_match == -1) direction = 1;
-  int current = last_match;
-  int i;
-  for (i = 0; i < E.numrows; i++) {
-    current += direction;
-    if (current == -1) current = E.numrows - 1;
-    else if (current == E.numrows) current = 0;
-    erow *row = &E.row[current];
-    char *match = strstr(row->render, query);
-    if (match) {
-      last_match = current;
-      E.cy = current;
-      E.cx = editorRowRxToCx(row, match - row->render);
-      E.rowoff = E.numrows;
-      break;
-    }
-  }
+  editorFreeRender(row);
+  if (row->ext) arenaFree(&E.arena, row->ext, sizeof(struct rowExt) + sizeof(int) * row->ext->cap);
+  // Free the memory allocated for the actual characters in the row, mapped rows don't own theirs
+  if (!(row->flags & ROW_MAPPED)) arenaFree(&E.arena, row->chars, row->cap);
 }
 
-void editorFind() {
-  int saved_cx = E.cx; // save the cursor position and scroll position
-  int saved_cy = E.cy;
-  int saved_coloff = E.coloff;
-  int saved_rowoff = E.rowoff;
-  char *query = editorPrompt("Search: %s (Use ESC/Arrows/Enter)",editorFindCallback);
-  if (query) {
-    free(query);
-  }else{
-    E.cx = saved_cx; //restore those values after the search is cancelled.
-    E.cy = saved_cy;
-    E.coloff = saved_coloff;
-    E.rowoff = saved_rowoff;
-  }
-}
 // Function to delete a row from the editor at a specified index
 void editorDelRow(int at) {
   // Check if the given index is valid
   if (at < 0 || at >= E.numrows) return;
 
   // Free the memory allocated for the row to be deleted
-  editorFreeRow(&E.row[at]);
+  editorFreeRow(rsAt(&E.rows, at));
 
-  // Move all subsequent rows up by one position
-  // This effectively overwrites the deleted row with the next row
-  memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+  // Remove the slot from the row store, the rows after it move up by one position
+  rsDelete(&E.rows, at);
 
   // Decrease the total number of rows in the editor
   E.numrows--;
@@ -622,11 +1338,12 @@ void editorDelRow(int at) {
   E.dirty++;
 }
 
-// Function to draw the rows of the editor
-void editorDrawRows(struct abuf *ab) {
+// Function to draw the rows of the editor, screen row y goes into lines[y]
+void editorDrawRows(struct abuf *lines) {
   int y;
   // Loop through each row of the screen
   for (y = 0; y < E.screenrows; y++) {
+    struct abuf *ab = &lines[y];
     // Calculate the actual file row, accounting for vertical scroll offset
     int filerow = y + E.rowoff;
     // If we're past the end of the file
@@ -647,7 +1364,7 @@ void editorDrawRows(struct abuf *ab) {
           padding--;
         }
         // Add spaces for padding
-        while (padding--) abAppend(ab, " ", 1);
+        abFill(ab, ' ', padding);
         // Append the welcome message
         abAppend(ab, welcome, welcomelen);
       } else {
@@ -657,54 +1374,45 @@ void editorDrawRows(struct abuf *ab) {
     } else {
       // We're drawing a row with file content
       // Calculate the length of the row to display, accounting for horizontal scroll
-      int len = E.row[filerow].size - E.coloff;
+      erow *row = rsAt(&E.rows, filerow);
+      if (row->size >= KILO_RX_MIN) {
+        // long rows are never rendered as a whole, only the part on screen is
+        editorDrawLongRow(ab, row);
+        continue;
+      }
+      // rows are rendered lazily, the first time they show up on screen
+      char *render = editorRowRender(row);
+      int len = row->rsize - E.coloff;
       if (len < 0) len = 0;
       // Truncate if it's longer than the screen width
       if (len > E.screencols) len = E.screencols;
       // Append the row content
-      abAppend(ab, &E.row[filerow].chars[E.coloff], len);
+      if (len > 0) abAppend(ab, &render[E.coloff], len);
     }
-
-    // Clear the rest of the line
-    abAppend(ab, "\x1b[K", 3);
-    // Add a newline, except for the last row
-    abAppend(ab, "\r\n", 2);
-  }
-}
-
-
-// this function concatenates all rows into a single string
-char *editorRowsToString(int *buflen) {
-  int totlen = 0;
-  int j;
-  // Calculate total length of all rows plus newline characters
-  for (j = 0; j < E.numrows; j++)
-    totlen += E.row[j].size + 1;
-  // Store total length in the provided pointer
-  *buflen = totlen;
-  // Allocate memory for the entire text content
-  char *buf = malloc(totlen);
-  char *p = buf;
-  // Copy each row's content into the buffer
-  for (j = 0; j < E.numrows; j++) {
-    // Copy the row's content
-    memcpy(p, E.row[j].chars, E.row[j].size);
-    // Move the pointer to the end of the copied content
-    p += E.row[j].size;
-    // Add a newline character
-    *p = '\n';
-    // Move the pointer past the newline
-    p++;
-  }
-  // Return the buffer containing all rows
-  return buf;
+  }
 }
 
+
 int editorRowRxToCx(erow *row, int rx) {
   int cur_rx = 0;
-  int cx;
-  for (cx = 0; cx < row->size; cx++) {
-    if (row->chars[cx] == '\t')
+  int cx = 0;
+  if (editorRowIndex(row, 0)) {
+    // extend the index until it passes rx, then binary search the last checkpoint at or before rx
+    struct rowExt *ext;
+    int n = row->size / KILO_RX_STEP + 1;
+    while ((ext = row->ext)->valid < n && ext->rx[ext->valid - 1] <= rx)
+      editorRowIndex(row, ext->valid + 15);
+    int lo = 0, hi = ext->valid - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (ext->rx[mid] <= rx) lo = mid;
+      else hi = mid - 1;
+    }
+    cur_rx = ext->rx[lo];
+    cx = lo * KILO_RX_STEP;
+  }
+  for (; cx < row->size; cx++) {
+    if (editorRowByte(row, cx) == '\t')
       cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
     cur_rx++;
     if (cur_rx > rx) return cx;
@@ -718,6 +1426,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
   char *buf = malloc(bufsize);
   size_t buflen = 0;
   buf[0] = '\0';  // Ensure the buffer starts as an empty string
+  E.prompting++;
   while (1) {
     // Display the prompt and current input in the status bar
     editorSetStatusMessage(prompt, buf);
@@ -734,12 +1443,16 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
       editorSetStatusMessage("");
       if (callback) callback(buf, c);
       free(buf);
+      E.prompting--;
+      editorFollowKick();
       return NULL;
     } else if (c == '\r') {
       // Handle return: if buffer is not empty, return the input
       if (buflen != 0) {
         editorSetStatusMessage("");
         if (callback) callback(buf, c);
+        E.prompting--;
+        editorFollowKick();
         return buf;
       }
     } else if (!iscntrl(c) && c < 128) {
@@ -752,41 +1465,28 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
       // Append the character to the buffer
       buf[buflen++] = c;
       buf[buflen] = '\0';  // Ensure the buffer remains null-terminated
-    }
-    if (callback) callback(buf, c);
-  }
-}
-
-void editorSave() {
-  if (E.filename == NULL) {
-    E.filename = editorPrompt("Save as:%s (ESC to cancel) ", editorFindCallback); 
-    if (E.filename == NULL) {
-      editorSetStatusMessage("Save aborted");
-      return;
-    }
-  }
-  int len;
-  char *buf = editorRowsToString(&len);
-  int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
-  if (fd != -1) {
-    if (ftruncate(fd, len) != -1) {
-      if (write(fd, buf, len) == len) {
-        close(fd);
-        free(buf);
-        E.dirty = 0;
-        editorSetStatusMessage("%d bytes written to disk", len);
-        return;
+    } else if (c == PASTE_EVENT) {
+      // a paste goes into the prompt as if it was typed, newlines and other control characters are dropped
+      for (int i = 0; i < E.paste.len; i++) {
+        unsigned char ch = E.paste.b[i];
+        if (iscntrl(ch) || ch >= 128) continue;
+        if (buflen == bufsize - 1) {
+          bufsize *= 2;
+          buf = realloc(buf, bufsize);
+        }
+        buf[buflen++] = ch;
       }
+      buf[buflen] = '\0';
     }
-    close(fd);
+    // a worker woke us: the save may be done or the followed file grew, whatever else woke us is for the callback
+    if (c == WAKE_EVENT) {
+      editorSavePoll();
+      editorFollowPoll();
+    }
+    if (callback) callback(buf, c);
   }
-  free(buf);
-  editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
 }
 
-
-
-
 /* init */
 void initEditor() { // & refer to pass by reference, this way the data actually changed
   //init the screen size for the text editor (horizontal and vertical)
@@ -796,51 +1496,132 @@ void initEditor() { // & refer to pass by reference, this way the data actually
   E.numrows = 0;
   E.rowoff = 0;
   E.coloff = 0; // initialize column offsets
-  E.row = NULL;
+  rsInit(&E.rows);
   E.dirty = 0;
   E.filename = NULL;
+  E.map = NULL;
+  E.mapsize = 0;
+  E.mapheap = 0;
+  E.indexed = 0;
+  E.threads = 1;
+  E.prompting = 0;
   E.statusmsg[0] = '\0';
   E.statusmsg_time = 0;
+  E.front = E.back = NULL;
+  E.screenlines = 0;
+  E.fullRedraw = 1;
+  E.termRow = E.termCol = E.termAttr = -1;
+  E.frameBytes = 0;
+  E.totalFrameBytes = 0;
+  E.frames = 0;
+  E.lastFrameTime = E.inputTime = 0;
+  E.frameKeys = 0;
+  E.lastLatency = E.maxLatency = E.totalLatency = 0;
+  E.latencyFrames = E.skippedFrames = 0;
+  E.frameAllocs = 0;
+  E.out = (struct abuf)ABUF_INIT;
+  E.paste = (struct abuf)ABUF_INIT;
   if (getWindowSize(&E.screenrows, &E.screencols) == -1) die("getWindowSize");
   E.screenrows -= 2;
 }
+
+// point a row at chars, the same text in the mapping of the file that was just saved, and drop its own copy
+void editorRemapRow(erow *row, char *chars) {
+  if (!(row->flags & ROW_MAPPED)) arenaFree(&E.arena, row->chars, row->cap);
+  if (row->ext) row->ext->gapLen = 0;
+  if (row->chars != chars) row->flags |= ROW_DIRTY; // same text, but a shared render still points at the old chars
+  row->chars = chars;
+  row->cap = 0;
+  row->flags |= ROW_MAPPED;
+}
+
+// rsEach visitor: point n rows at their text in the new mapping, *arg is where the next row starts
+static int editorRemapVisit(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  char **p = arg;
+  for (int i = 0; i < n; i++) {
+    editorRemapRow(&rows[i], *p);
+    *p += rows[i].size + 1;
+  }
+  return 1;
+}
+
+// after a save the rows move over to map, len bytes of the file that was just written, and the old mapping goes
+// this also drops the copies of edited rows
+void editorRemapRows(char *map, size_t len) {
+  char *p = map;
+  rsEach(&E.rows, 0, editorRemapVisit, &p);
+  editorUnmapFile();
+  E.map = map;
+  E.mapsize = E.indexed = len;
+}
+
+// release the mapping of the opened file, files that could not be mapped were read into the heap instead
+void editorUnmapFile() {
+  if (E.map == NULL) return;
+  if (E.mapheap) free(E.map);
+  else munmap(E.map, E.mapsize);
+  E.map = NULL;
+  E.mapheap = 0;
+}
+
+// drop every row and the mapping, leaving an empty buffer
+void editorCloseFile() {
+  editorSaveWait(); // the save is still reading the rows
+  editorJournalClose(1);
+  // all the row text lives in the arena, so there is no need to visit the rows one by one
+  arenaReset(&E.arena);
+  rsFree(&E.rows);
+  editorUndoClear();
+  editorUnmapFile();
+  E.numrows = 0;
+  E.mapsize = E.indexed = 0;
+  E.cx = E.cy = E.rx = 0;
+  E.rowoff = E.coloff = 0;
+  E.dirty = 0;
+}
 // Function to append a new row to the editor's content
 // Parameters:
 //   s: Pointer to the string content of the new row
 //   len: Length of the string to be appended
 void editorInsertRow(int at, char *s, size_t len) {
     if (at < 0 || at > E.numrows) return; // check if the given index is valid
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1)); // reallocate memory for the new row
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at)); // move all subsequent rows down by one position
+    erow *row = rsInsert(&E.rows, at); // open a slot in the row store, the rows after it move down by one position
 
     // Set the size of the new row
-    E.row[at].size = len;
+    row->size = len;
 
     // Allocate memory for the new row's content
     // +1 for the null terminator
-    E.row[at].chars = malloc(len + 1);
+    row->cap = arenaBlockSize(len + 1);
+    row->chars = arenaAlloc(&E.arena, row->cap);
 
     // Copy the content from the input string to the new row
-    memcpy(E.row[at].chars, s, len);
+    memcpy(row->chars, s, len);
 
     // Null-terminate the new row's content
-    E.row[at].chars[len] = '\0';
+    row->chars[len] = '\0';
 
     // Initialize render-related fields
     // These are likely used for handling special characters or formatting
-    E.row[at].rsize = 0;
-    E.row[at].render = NULL;
-    editorUpdateRow(&E.row[at]);
+    row->rsize = 0;
+    row->render = NULL;
+    row->flags = 0;
+    row->ext = NULL;
+    editorUpdateRow(row);
 
     // Increment the total number of rows in the editor
     E.numrows++;
     E.dirty++; // Update dirty to indicate that the file has been modified
 }
 void editorInsertChar(int c){
+  char ch = c;
+  editorJournal(JOURNAL_CHAR, E.cy, E.cx, &ch, 1);
+  editorRecordEdit(UNDO_INSERT, E.cy, E.cx, &ch, 1, 1);
   if (E.cy == E.numrows) {
     editorInsertRow(E.numrows, "", 0);
   }
-  editorRowInsertChar(&E.row[E.cy], E.cx,c);
+  editorRowInsertChar(rsAt(&E.rows, E.cy), E.cx,c);
   E.cx++;
 }
 
@@ -849,6 +1630,17 @@ void editorInsertChar(int c){
 void editorRowDelChar(erow *row, int at) {
     // Check if the deletion position is valid
     if (at < 0 || at >= row->size) return;
+    editorRowMaterialize(row);
+    if (row->size >= KILO_GAP_MIN) {
+      // a long row moves its gap to the character and lets the gap swallow it
+      editorRowMoveGap(row, at);
+      row->ext->gapLen++;
+      row->size--;
+      editorRowChanged(row, at);
+      E.dirty++;
+      return;
+    }
+    editorRowCloseGap(row);
     
     // Move the characters after 'at' one position to the left, effectively deleting the character at 'at'
     memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
@@ -857,7 +1649,7 @@ void editorRowDelChar(erow *row, int at) {
     row->size--;
     
     // Update the rendered version of the row
-    editorUpdateRow(row);
+    editorRowChanged(row, at);
     
     // Mark the file as modified
     E.dirty++;
@@ -868,44 +1660,100 @@ void editorDelChar() {
     // If the cursor is beyond the last row, there's nothing to delete
     if (E.cy == E.numrows) return;
     if (E.cx == 0 && E.cy == 0) return;
+    editorJournal(JOURNAL_DELCHAR, E.cy, E.cx, NULL, 0);
     
     // Get a pointer to the current row
-    erow *row = &E.row[E.cy];
+    erow *row = rsAt(&E.rows, E.cy);
     
     // If the cursor is not at the beginning of the line
     if (E.cx > 0) {
         // Delete the character before the cursor
+        char ch = editorRowByte(row, E.cx - 1);
+        editorRecordEdit(UNDO_DELETE, E.cy, E.cx - 1, &ch, 1, 1);
         editorRowDelChar(row, E.cx - 1);
         // Move the cursor one position to the left
         E.cx--;
     } else {
-      E.cx = E.row[E.cy - 1].size;
-      editorRowAppendString(&E.row[E.cy - 1], row->chars, row->size);
+      erow *prev = rsAt(&E.rows, E.cy - 1);
+      // joining two rows deletes the row boundary at the end of the previous one
+      editorRecordEdit(UNDO_DELETE, E.cy - 1, prev->size, "\n", 1, 1);
+      E.cx = prev->size;
+      editorRowCloseGap(row);
+      editorRowAppendString(prev, row->chars, row->size);
       editorDelRow(E.cy);
       E.cy--;
     }
     // Note: This function doesn't handle backspace at the beginning of a line yet
 }
 
+#ifndef KILO_NO_MAIN
 int main(int argc , char *argv[]) {
+  // parse the command line before the terminal is switched to raw mode, so errors print normally
+  char *filename = NULL;
+  int threads = 1;
+  int recover = 0;
+  int follow = 0;
+  size_t maxResident = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      char *end;
+      threads = strtol(argv[++i], &end, 10);
+      // 0 means one thread per online cpu
+      if (threads == 0 && *end == '\0') threads = sysconf(_SC_NPROCESSORS_ONLN);
+      if (*end != '\0' || threads < 1 || threads > KILO_MAX_THREADS) {
+        fprintf(stderr, "kilo: --threads must be between 0 and %d\n", KILO_MAX_THREADS);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--max-resident") == 0 && i + 1 < argc) {
+      // bytes, or with a K, M or G after the number
+      char *end;
+      maxResident = strtoull(argv[++i], &end, 10);
+      if (*end == 'K' || *end == 'k') maxResident <<= 10, end++;
+      else if (*end == 'M' || *end == 'm') maxResident <<= 20, end++;
+      else if (*end == 'G' || *end == 'g') maxResident <<= 30, end++;
+      if (*end != '\0' || maxResident == 0) {
+        fprintf(stderr, "kilo: --max-resident wants a size like 512M\n");
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--recover") == 0) {
+      recover = 1; // replay the journal a session that never quit left for the file
+    } else if (strcmp(argv[i], "--follow") == 0) {
+      follow = 1; // keep adding what is written to the end of the file, like tail -f
+    } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+      fprintf(stderr, "Usage: kilo [--threads N] [--max-resident SIZE] [--recover] [--follow] [filename]\n");
+      return 1;
+    } else {
+      filename = argv[i];
+    }
+  }
+
   // Clear the entire screen and scrollback buffer
   write(STDOUT_FILENO, "\x1b[2J", 4); // Clear the entire screen
   write(STDOUT_FILENO, "\x1b[3J", 4); // Clear the scrollback buffer
   write(STDOUT_FILENO, "\x1b[H", 3); // Move the cursor to the top-left corner
   enableRawMode();
   initEditor();
-  if (argc >= 2) {
-    editorOpen(argv[1]); 
+  E.threads = threads;
+  E.maxResident = maxResident;
+  if (filename) {
+    editorOpen(filename);
   }
   // asking read() to read 1 char byte for the standard input and put it into the variable c
   
   editorSetStatusMessage(
-  "HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find");
+  "HELP: Ctrl-S = save | Ctrl-Q = quit | Ctrl-F = find | Ctrl-Z/Y = undo/redo");
+  // after the help, so what it found of an old journal is what the status bar shows
+  editorJournalOpen(recover);
+  if (follow && filename) editorFollowOpen();
   
   while(1){
     editorRefreshScreen();
     editorProcessKeyPress();
-    }
+    // handle every key that is already waiting, or that arrives before the next frame is due, then draw once
+    while (editorInputBefore(E.lastFrameTime + 1000000 / KILO_MAX_FPS))
+      editorProcessKeyPress();
+  }
   // run echo $? to get the return value
   return 0;
 }
+#endif /* KILO_NO_MAIN */
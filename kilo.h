@@ -5,7 +5,50 @@
 #define KILO_VERSION "0.0.2"
 #define KILO_QUIT_TIMES 2 // number of times to allow unsaved changes before quitting
 #define KILO_TAB_STOP 8 // number of spaces per tab stop
-#define ABUF_INIT {NULL, 0} // initialize an empty buffer
+#define ABUF_INIT {NULL, 0, 0} // initialize an empty buffer
+#define RS_CHUNK 64 // number of rows held by one chunk of the row store
+#define KILO_INDEX_STEP (16 * 1024 * 1024) // bytes of the mapped file indexed per background step
+#define KILO_INDEX_BATCH 1024 // newline offsets collected per call to the line scanner
+#define KILO_MAX_THREADS 256 // upper limit for --threads
+#define KILO_INPUT_RING 65536 // bytes of keyboard input buffered between reads, must be a power of two
+#define KILO_ESC_TIMEOUT 50 // ms to wait for the rest of an escape sequence before taking it as the escape key
+#define KILO_MAX_FPS 60 // frames per second at most, keys arriving faster are handled together in one frame
+#define KILO_ARENA_CHUNK (1024 * 1024) // bytes the row text arena takes from malloc at a time
+#define ARENA_CLASSES 32 // size classes of the arena, see arena.c
+#define KILO_RX_STEP 256 // bytes between two rx checkpoints of a long row
+#define KILO_RX_MIN 1024 // rows shorter than this are scanned instead of indexed
+#define KILO_GAP_MIN (64 * 1024) // rows this long are edited as a gap buffer
+#define KILO_GAP (16 * 1024) // smallest gap opened in a long row
+#define KILO_UNDO_MAX (64 * 1024 * 1024) // bytes of undo history kept, older edits are forgotten
+#define KILO_MATCH_MAX (4 * 1024 * 1024) // search matches listed at most, a query with more is searched row by row
+#define KILO_FIND_TASK 16384 // rows a search worker takes at a time, see search.c
+#define KILO_SAVE_IOV 1024 // pieces of rows written by one writev() at most, the usual IOV_MAX
+#define KILO_SAVE_BATCH (8 * 1024 * 1024) // bytes gathered before a save calls writev()
+#define KILO_SAVE_PATCHES 4096 // changed ranges a save patches in place at most, more and the file is written again
+#define KILO_SAVE_PATCH_MAX (64 * 1024 * 1024) // changed bytes a save patches in place at most
+#define KILO_JOURNAL_MS 100 // the journal is written and synced this long after the first edit not on disk yet
+#define KILO_JOURNAL_BATCH (1024 * 1024) // bytes of edits that are written right away, without waiting
+#define KILO_FOLLOW_CHUNK (1024 * 1024) // bytes --follow reads from the end of the file per wakeup, see follow.c
+#define KILO_PAGE_ROWS 4096 // rows in a page of a file opened with --max-resident, the line index has one entry per page
+#define KILO_REGEX_STATES 2048 // DFA states a regex caches before starting over, must be a power of two
+#define UNDO_INSERT 1 // kinds of undo records, see undo.c
+#define UNDO_DELETE 2
+#define UNDO_REPLACE 3 // a whole replace-all, see editorRecordReplace()
+#define JOURNAL_CHAR 1 // kinds of journal records, see journal.c
+#define JOURNAL_NEWLINE 2
+#define JOURNAL_DELCHAR 3
+#define JOURNAL_INSERT 4
+#define JOURNAL_DELETE 5
+#define JOURNAL_REPLACE 6
+#define JOURNAL_ROW 7 // undo and redo add or remove the row past the end
+#define JOURNAL_DELROW 8
+#define SEARCH_ICASE 1 // textSearch() flag: ASCII letters match either case
+#define SEARCH_WORD 2 // textSearch() flag: only matches that are whole words
+#define SEARCH_REGEX 4 // search prompt flag: the query is a regular expression, see regex.c
+#define ROW_MAPPED 1 // chars points into the mapped file, it is not owned and not null-terminated
+#define ROW_DIRTY 2 // chars changed since render was built
+#define ROW_SHARED 4 // render is chars itself, the row has no tabs or control characters
+#define ROW_PAGED 8 // a row of a page that is paged out, made up for rsEach(), changes to it are lost
 #define _DEFAULT_SOURCE // needed for getline
 #define _BSD_SOURCE // needed for strdup
 #define _GNU_SOURCE // needed for strdup
@@ -24,6 +67,13 @@
 #include <stdarg.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <stdint.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/inotify.h>
 
 
 
@@ -32,15 +82,70 @@
 //E.cx is the horizontal coordinate of the cursor (the column) and E.cy is the vertical coordinate (the row).
 
 
+//extra data only long rows have
+struct rowExt {
+  int cap; //checkpoints allocated
+  int valid; //checkpoints computed, the rest are recomputed on demand
+  int gapStart, gapLen; //gap buffer of a long row being edited, gapLen 0 when chars is contiguous
+  int rx[]; //rx[k] is the render column of byte k * KILO_RX_STEP
+};
+
 //erow stand for "Editor Row"
 typedef struct erow{
   int size; //row size in bytes
   int rsize; //row size in characters
   char *chars; //pointets for characters
-  char *render; //rendered row with highlights
+  char *render; //rendered row, NULL until the row is first drawn, may be chars itself (ROW_SHARED)
+  int flags; //ROW_MAPPED, ROW_DIRTY, ROW_SHARED
+  int cap; //bytes allocated for chars in the arena, 0 while chars points into the mapped file
+  struct rowExt *ext; //rx checkpoints and gap of a long row, NULL until a long row needs them
 } erow;
 
+/*** append buffer ***/
+/*
+An append buffer consists of a pointer to our buffer in memory, and a length. We define an ABUF_INIT constant which represents an empty buffer
+as using a bunch of small write() is not good for performance, we use a append buffer to make a big write which write the whole screen at once
+*/ 
+struct abuf {
+  char *b;
+  int len;
+  int cap; //bytes allocated for b, grows by doubling
+};
 
+//a piece of a row to replace: len bytes at row, col make way for tlen bytes of text
+struct replaceSpan {
+  int row, col;
+  int len;
+  const char *text;
+  int tlen;
+};
+
+//the arena the row text is allocated from, see arena.c
+struct arenaChunk;
+struct arenaBig;
+struct arena {
+  struct arenaChunk *chunks; //every chunk blocks are carved from
+  char *next, *end; //free space left in the newest chunk
+  void *free[ARENA_CLASSES]; //freed blocks of each size class
+  struct arenaBig *big; //blocks too big for a size class, malloc'd one by one
+  int nchunks;
+  size_t used; //bytes in blocks handed out
+  size_t freeBytes; //bytes waiting on the free lists
+  size_t bigBytes; //bytes malloc'd for the big blocks
+};
+
+//the row store holds all the rows of the file, see rowstore.c
+struct rsNode;
+struct rowStore {
+  struct rsNode *root; //root of the treap of row chunks
+  struct rsNode *finger; //chunk of the last lookup, makes walking rows in order cheap
+  int fingerStart; //index of the first row in the finger chunk
+  int epoch; //goes up with every snapshot, see rsSnapshot()
+  int frozen; //nodes made in this epoch or before belong to the snapshot, -1 when there is none
+  size_t resident; //bytes the pages that are in take, see rsTrim()
+  size_t trimmed; //resident after the last rsTrim()
+  unsigned long clock; //counts page lookups, the least recently used page goes first
+};
 
 struct editorConfig {
   int cx, cy;
@@ -51,8 +156,35 @@ struct editorConfig {
   int screencols;
   int numrows;
   int dirty;
-  erow *row;
+  struct rowStore rows;
+  struct arena arena; //chars and render of the rows
   char *filename;
+  char *map; //the opened file mapped read-only, rows that were not edited point into it
+  size_t mapsize;
+  int mapheap; //1 when map was read into the heap because the file could not be mapped
+  struct stat mapstat; //the file map came from, a save patches the file in place only while it is still that file
+  size_t indexed; //bytes of the mapping already split into rows
+  int threads; //worker threads used to index and search the file, set with --threads
+  size_t maxResident; //bytes of the file's pages kept in memory, set with --max-resident, 0 to keep every row
+  int prompting; //editorPrompt() calls that are open, a followed file is not opened again under one
+  struct abuf *front; //screen lines the terminal shows now
+  struct abuf *back; //screen lines of the frame being drawn
+  int screenlines; //number of lines in front and back
+  int fullRedraw; //1 when the next frame must repaint everything
+  int termRow, termCol; //where the terminal cursor is, -1 when unknown
+  int termAttr; //attribute the terminal is drawing with, 1 = inverted, -1 when unknown
+  struct abuf out; //escape sequences for the frame being written, reused every frame
+  int frameBytes; //bytes written for the last frame
+  int frameAllocs; //append buffer allocations during the last frame, 0 once the buffers are warm
+  long totalFrameBytes;
+  long frames;
+  long lastFrameTime; //microseconds when the last frame was written
+  long inputTime; //microseconds when the oldest key not yet on screen arrived, 0 when none
+  int frameKeys; //keys handled since the last frame
+  long lastLatency, maxLatency, totalLatency; //input to paint time in microseconds
+  long latencyFrames; //frames that painted at least one key
+  long skippedFrames; //frames not drawn because their keys were folded into a later frame
+  struct abuf paste; //text of the last bracketed paste, see PASTE_EVENT
   char statusmsg[80];
   time_t statusmsg_time;
   struct termios orig_termios;
@@ -61,16 +193,6 @@ struct editorConfig {
 
 
 
-/*** append buffer ***/
-/*
-An append buffer consists of a pointer to our buffer in memory, and a length. We define an ABUF_INIT constant which represents an empty buffer
-as using a bunch of small write() is not good for performance, we use a append buffer to make a big write which write the whole screen at once
-*/ 
-struct abuf {
-  char *b;
-  int len;
-};
-
 enum editorKeyP{
   BACKSPACE = 127,
   ARROW_LEFT = 1000,
@@ -82,9 +204,11 @@ enum editorKeyP{
   HOME_KEY,
   END_KEY,
   DEL_KEY,
+  PASTE_EVENT, //a bracketed paste arrived, the text is in E.paste
+  WAKE_EVENT, //a worker thread called editorWake(), it has results for the main loop
 };
 
-struct editorConfig E;
+extern struct editorConfig E;
 
 
 // Function prototypes
@@ -97,33 +221,160 @@ void disableRawMode();
 void enableRawMode();
 void abAppend(struct abuf *ab, const char *s, int len);
 void abFree(struct abuf *ab);
+void abFill(struct abuf *ab, char c, int n);
+void abReset(struct abuf *ab);
+extern long abAllocs;
 void editorMoveCursor(int key);
 void editorProcessKeyPress();
-void editorDrawRows(struct abuf *ab);
+void editorDrawRows(struct abuf *lines);
+void editorResizeScreen(int nlines);
+void editorDrawLineDiff(struct abuf *ab, int y, struct abuf *old, struct abuf *new);
+void editorMoveTo(struct abuf *ab, int y, int x);
+void editorSetAttr(struct abuf *ab, int a);
+void editorInvalidateScreen();
+void editorShowStats();
 void initEditor();
-void editorOpen();
+void editorOpen(char *filename);
+void editorIndexRows(int upto, size_t budget);
+void editorIndexTo(int upto);
+void editorIndexInBackground();
+int editorInputPending();
+int editorFillInput(int timeout);
+int editorInputBefore(long deadline);
+void editorWakeInit();
+void editorWake();
+long editorNow();
+void editorRowMaterialize(erow *row);
+void editorRemapRow(erow *row, char *chars);
+void editorRowUnshare(erow *row);
+void editorFreeUnshared();
+void editorRemapRows(char *map, size_t len);
+void editorUnmapFile();
+void editorCloseFile();
+void editorIndexParallel(size_t budget);
+int editorPageRows(const char **p, const char *end, erow *rows, int max);
+int editorPageOut(erow *rows, int n, char **base, size_t *len);
+void editorPageTrim();
+
+// line index
+typedef size_t (*lineIndexFn)(const char *buf, size_t len, size_t *offs, size_t max);
+size_t lineIndexScan(const char *buf, size_t len, size_t *offs, size_t max);
+size_t lineIndexScalar(const char *buf, size_t len, size_t *offs, size_t max);
+#if defined(__x86_64__) || defined(__i386__)
+size_t lineIndexSSE2(const char *buf, size_t len, size_t *offs, size_t max);
+size_t lineIndexAVX2(const char *buf, size_t len, size_t *offs, size_t max);
+#endif
+const char *lineIndexName();
+
+// text search
+typedef long (*textSearchFn)(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags);
+long textSearch(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags);
+long textSearchScalar(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags);
+#if defined(__x86_64__) || defined(__i386__)
+long textSearchSSE2(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags);
+long textSearchAVX2(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags);
+#endif
+int textMatchAt(const char *buf, size_t len, size_t pos, const char *needle, size_t nlen, int flags);
+const char *textSearchName();
+
+// regex
+struct regex;
+struct regex *regexCompile(const char *pattern, int flags, const char **err);
+void regexFree(struct regex *re);
+const char *regexPrefix(struct regex *re, int *len);
+long regexFind(struct regex *re, const char *buf, size_t len, size_t from, size_t *end);
 void editorInsertRow(int at, char *s, size_t len);
 void editorUpdateRow(erow *row);
+void editorRenderRow(erow *row);
+char *editorRowRender(erow *row);
 int editorRowCxToRx(erow *row, int cx);
+int editorRowIndex(erow *row, int k);
+void editorRowChanged(erow *row, int at);
+char editorRowByte(erow *row, int i);
+const char *editorRowSegment(erow *row, int start, int len, char *tmp);
+void editorRowCloseGap(erow *row);
+void editorRowMoveGap(erow *row, int at);
+void editorDrawLongRow(struct abuf *ab, erow *row);
 void editorDrawStatusBar(struct abuf *ab);
 void editorSetStatusMessage(const char *fmt, ...);
 void editorDrawMessageBar(struct abuf *ab);
 void editorRowInsertChar(erow *row, int at, int c);
 void editorInsertChar(int c);
 void editorScroll();
-char *editorRowsToString(int *buflen);
-void editorSave();
 void editorRowDelChar(erow *row, int at);
 void editorDelChar();
 void editorFreeRow(erow *row);
 void editorDelRow(int at);
 void editorRowAppendString(erow *row, char *s, size_t len);
 void editorInsertNewline();
+void editorInsertText(const char *s, int len);
+void editorDeleteText(int cy, int cx, int len);
+void editorReplaceSpans(struct replaceSpan *spans, int n);
 char *editorPrompt(char *prompt, void (*callback)(char *, int));
 void editorFind();
 void editorFindCallback(char *query, int key);
+int editorFindCount();
+int editorReplaceAll(const char *rep, int rlen);
+int editorFindIdle();
 int editorRowRxToCx(erow *row, int rx);
 
+// undo
+void editorRecordEdit(int type, int cy, int cx, const char *s, int len, int typed);
+void editorRecordReplace(struct replaceSpan *spans, int n, const char *rep, int rlen);
+void editorUndo();
+void editorRedo();
+void editorUndoClear();
+size_t editorUndoBytes(int *records);
+
+// save
+void editorSave();
+void editorSavePoll();
+void editorSaveWait();
+int editorSaving();
+
+// journal
+void editorJournalOpen(int recover);
+void editorJournal(int op, int cy, int cx, const char *s, int len);
+void editorJournalSpans(struct replaceSpan *spans, int n);
+void editorJournalSync();
+void editorJournalReset();
+size_t editorJournalMark();
+void editorJournalRebase(size_t mark, struct stat *st);
+void editorJournalClose(int remove);
+size_t editorJournalStats(long *records, long *syncs);
+
+// follow
+void editorFollowOpen();
+void editorFollowPoll();
+void editorFollowSaved(size_t len);
+void editorFollowKick();
+long editorFollowStats(long *polls);
+
+// arena
+void *arenaAlloc(struct arena *a, size_t n);
+void arenaFree(struct arena *a, void *p, size_t n);
+void *arenaRealloc(struct arena *a, void *p, int *cap, size_t n);
+size_t arenaBlockSize(size_t n);
+void arenaReset(struct arena *a);
+size_t arenaReserved(struct arena *a);
+
+// row store
+void rsInit(struct rowStore *rs);
+int rsCount(struct rowStore *rs);
+erow *rsAt(struct rowStore *rs, int at);
+typedef int (*rsVisitFn)(erow *rows, int n, int start, void *arg);
+void rsEach(struct rowStore *rs, int at, rsVisitFn fn, void *arg);
+erow *rsInsert(struct rowStore *rs, int at);
+void rsDelete(struct rowStore *rs, int at);
+void rsFree(struct rowStore *rs);
+void rsAppendRows(struct rowStore *rs, erow *rows, int n);
+void rsInsertRows(struct rowStore *rs, int at, erow *rows, int n);
+void rsDeleteRows(struct rowStore *rs, int at, int n);
+void rsSnapshot(struct rowStore *rs, struct rowStore *snap);
+void rsRelease(struct rowStore *rs, struct rowStore *snap);
+void rsAppendPage(struct rowStore *rs, char *base, size_t len, int n);
+void rsTrim(struct rowStore *rs, size_t budget);
+
 
 
 #endif /* KILO_H_ */
\ No newline at end of file
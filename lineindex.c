@@ -0,0 +1,98 @@
+#include "kilo.h"
+
+/*** line index ***/
+/*
+The line index finds the offsets of all the '\n' bytes in a buffer, this is how a file gets split into rows.
+Instead of looking at one byte at a time we compare 16 (SSE2) or 32 (AVX2) bytes at once against '\n',
+turn the result into a bit mask and pull the offsets out of the mask.
+The best version the cpu supports is picked the first time lineIndexScan() is called.
+*/
+
+// plain byte by byte version, used when the cpu has no vector unit we know about
+size_t lineIndexScalar(const char *buf, size_t len, size_t *offs, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < len && n < max; i++) {
+    if (buf[i] == '\n') offs[n++] = i;
+  }
+  return n;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// store the offset of every set bit of mask, base is the offset of bit 0
+#define LINE_INDEX_EMIT(mask, base) \
+  while ((mask) && n < max) { \
+    offs[n++] = (base) + __builtin_ctz(mask); \
+    (mask) &= (mask) - 1; \
+  }
+
+__attribute__((target("sse2")))
+size_t lineIndexSSE2(const char *buf, size_t len, size_t *offs, size_t max) {
+  const __m128i nl = _mm_set1_epi8('\n');
+  size_t n = 0, i = 0;
+  for (; i + 16 <= len && n < max; i += 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)(buf + i));
+    unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+    LINE_INDEX_EMIT(mask, i);
+  }
+  if (n < max && i < len) {
+    size_t tail = lineIndexScalar(buf + i, len - i, offs + n, max - n);
+    for (size_t j = n; j < n + tail; j++) offs[j] += i;
+    n += tail;
+  }
+  return n;
+}
+
+__attribute__((target("avx2")))
+size_t lineIndexAVX2(const char *buf, size_t len, size_t *offs, size_t max) {
+  const __m256i nl = _mm256_set1_epi8('\n');
+  size_t n = 0, i = 0;
+  // two vectors per iteration, newlines are rare so most iterations only test one combined mask
+  for (; i + 64 <= len && n < max; i += 64) {
+    __m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + i)), nl);
+    __m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(buf + i + 32)), nl);
+    if (_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_or_si256(a, b))) continue;
+    unsigned int lo = _mm256_movemask_epi8(a);
+    unsigned int hi = _mm256_movemask_epi8(b);
+    LINE_INDEX_EMIT(lo, i);
+    LINE_INDEX_EMIT(hi, i + 32);
+  }
+  if (n < max && i < len) {
+    size_t tail = lineIndexSSE2(buf + i, len - i, offs + n, max - n);
+    for (size_t j = n; j < n + tail; j++) offs[j] += i;
+    n += tail;
+  }
+  return n;
+}
+#endif
+
+static lineIndexFn lineIndexImpl = NULL;
+static const char *lineIndexImplName = "scalar";
+
+static void lineIndexPick() {
+  lineIndexImpl = lineIndexScalar;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    lineIndexImpl = lineIndexAVX2;
+    lineIndexImplName = "avx2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    lineIndexImpl = lineIndexSSE2;
+    lineIndexImplName = "sse2";
+  }
+#endif
+}
+
+// find up to max newlines in buf and store their offsets in offs, returns how many were found
+// when the result equals max there may be more, scan again starting after the last offset
+size_t lineIndexScan(const char *buf, size_t len, size_t *offs, size_t max) {
+  if (lineIndexImpl == NULL) lineIndexPick();
+  return lineIndexImpl(buf, len, offs, max);
+}
+
+// name of the version lineIndexScan() uses, for the benchmark and the status bar
+const char *lineIndexName() {
+  if (lineIndexImpl == NULL) lineIndexPick();
+  return lineIndexImplName;
+}
@@ -0,0 +1,121 @@
+#include "kilo.h"
+
+/*** parallel load ***/
+/*
+With --threads N the mapped file is indexed by N worker threads instead of one.
+The range to index is cut into N pieces that end right after a newline, so no line is split between two workers.
+Each worker finds the lines of its piece and builds their rows, still pointing into the mapping.
+Nothing is rendered here, a row is rendered the first time it is drawn.
+The main thread then appends the rows of every worker in piece order, so the result is the same whatever
+the thread count and the timing of the workers.
+*/
+
+struct loadJob {
+  char *start; // first byte of the piece
+  char *end; // one past the last byte of the piece
+  erow *rows; // rows built by the worker
+  int n;
+  int cap;
+  int failed; // the rows could not be allocated, the main thread reports it once every worker is done
+};
+
+static void *editorLoadWorker(void *arg) {
+  struct loadJob *job = arg;
+  size_t offs[KILO_INDEX_BATCH];
+  char *p = job->start;
+  job->n = 0;
+  job->cap = 1024;
+  job->failed = 0;
+  job->rows = malloc(sizeof(erow) * job->cap);
+  if (job->rows == NULL) {
+    job->failed = 1;
+    return NULL;
+  }
+  while (p < job->end) {
+    char *base = p;
+    size_t n = lineIndexScan(base, job->end - base, offs, KILO_INDEX_BATCH);
+    // a piece ends right after a newline, only the last piece of the file can end without one
+    int last = n == 0;
+    if (last) n = 1;
+    for (size_t i = 0; i < n; i++) {
+      char *eol = last ? job->end : base + offs[i];
+      size_t len = eol - p;
+      while (len > 0 && p[len - 1] == '\r') len--;
+      if (job->n == job->cap) {
+        // die() would exit under the feet of the other workers, so the failure goes back to the main thread
+        erow *rows = realloc(job->rows, sizeof(erow) * job->cap * 2);
+        if (rows == NULL) {
+          job->failed = 1;
+          return NULL;
+        }
+        job->rows = rows;
+        job->cap *= 2;
+      }
+      erow *row = &job->rows[job->n++];
+      row->size = len;
+      row->chars = p;
+      row->rsize = 0;
+      row->render = NULL;
+      row->flags = ROW_MAPPED;
+      row->cap = 0;
+      row->ext = NULL;
+      p = last ? job->end : eol + 1;
+    }
+  }
+  return NULL;
+}
+
+// index about budget bytes of the mapped file (extended to the next line end) with E.threads workers
+void editorIndexParallel(size_t budget) {
+  int nthreads = E.threads;
+  char *start = E.map + E.indexed;
+  char *end = E.map + E.mapsize;
+  char *stop = end;
+  if (budget < (size_t)(end - start)) {
+    char *nl = memchr(start + budget, '\n', end - (start + budget));
+    stop = nl ? nl + 1 : end;
+  }
+  size_t len = stop - start;
+  if (len == 0) return;
+  // pieces smaller than one index step are not worth a thread
+  if ((size_t)nthreads > len / (1 << 20) + 1) nthreads = len / (1 << 20) + 1;
+
+  struct loadJob jobs[KILO_MAX_THREADS];
+  pthread_t tids[KILO_MAX_THREADS];
+  char *p = start;
+  for (int i = 0; i < nthreads; i++) {
+    char *cut = stop;
+    if (i < nthreads - 1) {
+      char *guess = start + len / nthreads * (i + 1);
+      if (guess < p) guess = p;
+      char *nl = memchr(guess, '\n', stop - guess);
+      cut = nl ? nl + 1 : stop;
+    }
+    jobs[i].start = p;
+    jobs[i].end = cut;
+    p = cut;
+  }
+  for (int i = 1; i < nthreads; i++) {
+    if (pthread_create(&tids[i], NULL, editorLoadWorker, &jobs[i]) != 0) die("pthread_create");
+  }
+  editorLoadWorker(&jobs[0]); // the main thread takes the first piece itself
+
+  int failed = jobs[0].failed;
+  for (int i = 1; i < nthreads; i++) {
+    pthread_join(tids[i], NULL);
+    failed |= jobs[i].failed;
+  }
+  if (failed) {
+    for (int i = 0; i < nthreads; i++) free(jobs[i].rows);
+    errno = ENOMEM;
+    die("malloc");
+  }
+
+  // merge in piece order, the row order never depends on which worker finished first
+  for (int i = 0; i < nthreads; i++) {
+    rsAppendRows(&E.rows, jobs[i].rows, jobs[i].n);
+    E.numrows += jobs[i].n;
+    free(jobs[i].rows);
+  }
+  E.indexed = stop - E.map;
+}
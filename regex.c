@@ -0,0 +1,742 @@
+#include "kilo.h"
+
+/*** regex ***/
+/*
+Regular expressions for the search prompt, matched by automata so the time is linear in the text whatever
+the pattern: there is no backtracking.
+The pattern is compiled into a Thompson NFA (states that consume one byte out of a set, and epsilon splits),
+once forwards and once with every concatenation reversed. The NFAs are never simulated directly: a DFA whose
+states are sets of NFA states is built lazily while matching, each transition the first time some text takes it,
+and kept in a cache of KILO_REGEX_STATES states that is flushed when it fills up. After a few rows of text
+nearly every byte is one table lookup.
+Finding a match (leftmost start, longest end, like POSIX) uses three DFAs:
+- an unanchored forward one that answers "is there a match in this row at all" and rejects most rows,
+- a reverse one run from the end of the row back to the start, which marks every position a match starts at,
+- an anchored forward one run from a start to find where the longest match ends.
+When every match has to start with some literal text ("ERROR" in ERROR.*timeout=[0-9]+) the rows are first
+searched for that prefix with textSearch(), and only the places it occurs go through the anchored DFA.
+Syntax: literals, . [abc] [^a-z] \d \w \s (and \D \W \S), \n \t, escaped punctuation, ( ) (?: ) |, * + ? {m} {m,} {m,n},
+and ^ $ at the very start and end of the pattern (the start and end of the row).
+*/
+
+#define RE_SET 1 // consume one byte that is in set, go to out[0]
+#define RE_SPLIT 2 // go to out[0] and out[1] without consuming anything
+#define RE_EPS 3 // go to out[0] without consuming anything
+#define RE_MATCH 4
+
+#define RE_MAX_NFA 20000 // NFA states a pattern may compile to
+#define RE_MAX_REPEAT 1000 // largest count in {m,n}
+#define RE_MAX_PREFIX 64 // bytes of literal prefix used for the prefilter
+
+struct reState {
+  int type;
+  int out[2];
+  unsigned char set[32]; // bit c is set when byte c is accepted, RE_SET only
+};
+
+struct reNfa {
+  struct reState *s;
+  int n;
+  int cap;
+  int start;
+};
+
+// a DFA state: the RE_SET and RE_MATCH states of the NFA it stands for
+struct reDState {
+  int *set;
+  int n;
+};
+
+// DFA states are passed around as their index with these flags or'ed in, so the matching loops
+// learn everything they need about the next state from the one transition table lookup
+#define RE_ACCEPT (1 << 30) // the set holds RE_MATCH
+#define RE_DEAD (1 << 29) // the set is empty, nothing can match from here on
+#define RE_ID (RE_DEAD - 1)
+
+struct reDfa {
+  struct reNfa *nfa;
+  int unanchored; // a match may start at any byte, the NFA start is added after every step
+  struct reDState **states;
+  int *next; // 256 transitions per state, the next state with its flags, -1 until first needed
+  int *code; // each state's index with its flags
+  int n;
+  int start; // -1 until built
+  int skip; // the only byte that leaves the start state of an unanchored DFA, -1 if there are more
+  int *hash; // open addressing table of state indexes, -1 for a free slot
+  int hashCap;
+  int flushes; // times the cache was started over
+  int *mark; // per NFA state, == gen when already in the set being built
+  int gen;
+  int *stack;
+  int *list;
+  int nlist;
+};
+
+struct regex {
+  struct reNfa fwd, rev;
+  struct reDfa search, match, back;
+  int flags;
+  int anchorStart, anchorEnd;
+  char prefix[RE_MAX_PREFIX];
+  int plen;
+  // starts of matches in the last buffer a reverse pass ran over, see regexFind()
+  const char *startsBuf;
+  size_t startsLen;
+  unsigned char *starts;
+  size_t startsCap;
+};
+
+/*** regex: parser ***/
+
+struct reFrag {
+  int start;
+  int out; // list of dangling exits, (state << 1 | which), chained through the out fields, -1 ends it
+};
+
+struct reParser {
+  const char *p;
+  const char *end;
+  int flags;
+  int reverse; // build the reversed NFA
+  struct reNfa *nfa;
+  const char *err;
+};
+
+static int reNew(struct reParser *ps, int type) {
+  struct reNfa *nfa = ps->nfa;
+  // past the limit the pattern fails, but the state is still made so the parser can unwind
+  if (nfa->n >= RE_MAX_NFA && !ps->err) ps->err = "pattern too big";
+  if (nfa->n == nfa->cap) {
+    nfa->cap = nfa->cap ? nfa->cap * 2 : 64;
+    nfa->s = realloc(nfa->s, sizeof(struct reState) * nfa->cap);
+    if (nfa->s == NULL) die("realloc");
+  }
+  struct reState *st = &nfa->s[nfa->n];
+  memset(st, 0, sizeof(*st));
+  st->type = type;
+  st->out[0] = st->out[1] = -1;
+  return nfa->n++;
+}
+
+// point every exit on the list at state target
+static void rePatch(struct reNfa *nfa, int list, int target) {
+  while (list != -1) {
+    int *field = &nfa->s[list >> 1].out[list & 1];
+    list = *field;
+    *field = target;
+  }
+}
+
+// join two exit lists
+static int reJoin(struct reNfa *nfa, int a, int b) {
+  if (a == -1) return b;
+  int list = a;
+  while (nfa->s[list >> 1].out[list & 1] != -1) list = nfa->s[list >> 1].out[list & 1];
+  nfa->s[list >> 1].out[list & 1] = b;
+  return a;
+}
+
+static struct reFrag reEmpty(struct reParser *ps) {
+  int st = reNew(ps, RE_EPS);
+  return (struct reFrag){st, st << 1};
+}
+
+static struct reFrag reSet(struct reParser *ps, const unsigned char *set) {
+  int st = reNew(ps, RE_SET);
+  memcpy(ps->nfa->s[st].set, set, 32);
+  return (struct reFrag){st, st << 1};
+}
+
+// a then b, or b then a when building the reversed NFA
+static struct reFrag reConcat(struct reParser *ps, struct reFrag a, struct reFrag b) {
+  if (ps->reverse) {
+    struct reFrag t = a;
+    a = b;
+    b = t;
+  }
+  rePatch(ps->nfa, a.out, b.start);
+  return (struct reFrag){a.start, b.out};
+}
+
+static struct reFrag reAlt(struct reParser *ps, struct reFrag a, struct reFrag b) {
+  int st = reNew(ps, RE_SPLIT);
+  ps->nfa->s[st].out[0] = a.start;
+  ps->nfa->s[st].out[1] = b.start;
+  return (struct reFrag){st, reJoin(ps->nfa, a.out, b.out)};
+}
+
+// a*, a+ (plus) or a? (optional)
+static struct reFrag reRepeat(struct reParser *ps, struct reFrag a, int plus, int optional) {
+  int st = reNew(ps, RE_SPLIT);
+  ps->nfa->s[st].out[0] = a.start;
+  if (optional) return (struct reFrag){st, reJoin(ps->nfa, a.out, st << 1 | 1)};
+  rePatch(ps->nfa, a.out, st);
+  return (struct reFrag){plus ? a.start : st, st << 1 | 1};
+}
+
+static void reSetBit(unsigned char *set, int c) {
+  set[c >> 3] |= 1 << (c & 7);
+}
+
+static int reHasBit(const unsigned char *set, int c) {
+  return set[c >> 3] & (1 << (c & 7));
+}
+
+// add the other case of every letter in the set
+static void reFold(unsigned char *set) {
+  for (int c = 'a'; c <= 'z'; c++) {
+    if (reHasBit(set, c) || reHasBit(set, c - 32)) {
+      reSetBit(set, c);
+      reSetBit(set, c - 32);
+    }
+  }
+}
+
+// \d \w \s and their negations, returns 0 if e is not one of them
+static int reClassEscape(int e, unsigned char *set) {
+  int lower = tolower(e);
+  if (lower != 'd' && lower != 'w' && lower != 's') return 0;
+  unsigned char s[32] = {0};
+  for (int c = 0; c < 256; c++) {
+    if ((lower == 'd' && isdigit(c)) || (lower == 'w' && (isalnum(c) || c == '_')) || (lower == 's' && isspace(c)))
+      reSetBit(s, c);
+  }
+  for (int i = 0; i < 32; i++) set[i] |= e == lower ? s[i] : ~s[i];
+  return 1;
+}
+
+// the byte an escape stands for, -1 when it is not a plain byte
+static int reEscapeByte(int e) {
+  if (e == 'n') return '\n';
+  if (e == 't') return '\t';
+  if (e == 'r') return '\r';
+  if (ispunct(e) || e == ' ') return e;
+  return -1;
+}
+
+static struct reFrag reParseClass(struct reParser *ps) {
+  unsigned char set[32] = {0};
+  int negate = 0;
+  if (ps->p < ps->end && *ps->p == '^') {
+    negate = 1;
+    ps->p++;
+  }
+  int first = 1;
+  while (ps->p < ps->end && (*ps->p != ']' || first)) {
+    first = 0;
+    int lo = (unsigned char)*ps->p++;
+    if (lo == '\\' && ps->p < ps->end) {
+      int e = (unsigned char)*ps->p++;
+      if (reClassEscape(e, set)) continue;
+      lo = reEscapeByte(e);
+      if (lo == -1) {
+        ps->err = "unknown escape";
+        return reEmpty(ps);
+      }
+    }
+    int hi = lo;
+    if (ps->p + 1 < ps->end && ps->p[0] == '-' && ps->p[1] != ']') {
+      hi = (unsigned char)ps->p[1];
+      ps->p += 2;
+      if (hi == '\\' && ps->p < ps->end) hi = reEscapeByte((unsigned char)*ps->p++);
+      if (hi < lo) {
+        ps->err = "bad range";
+        return reEmpty(ps);
+      }
+    }
+    for (int c = lo; c <= hi; c++) reSetBit(set, c);
+  }
+  if (ps->p == ps->end) {
+    ps->err = "missing ]";
+    return reEmpty(ps);
+  }
+  ps->p++;
+  if (ps->flags & SEARCH_ICASE) reFold(set);
+  if (negate) {
+    for (int i = 0; i < 32; i++) set[i] = ~set[i];
+    set['\n' >> 3] &= ~(1 << ('\n' & 7));
+  }
+  return reSet(ps, set);
+}
+
+static struct reFrag reParseAlt(struct reParser *ps);
+
+static struct reFrag reParseAtom(struct reParser *ps) {
+  unsigned char set[32] = {0};
+  int c = (unsigned char)*ps->p++;
+  switch (c) {
+    case '(': {
+      if (ps->end - ps->p >= 2 && ps->p[0] == '?' && ps->p[1] == ':') ps->p += 2;
+      struct reFrag f = reParseAlt(ps);
+      if (ps->p == ps->end || *ps->p != ')') {
+        if (!ps->err) ps->err = "missing )";
+        return f;
+      }
+      ps->p++;
+      return f;
+    }
+    case '[':
+      return reParseClass(ps);
+    case '.':
+      memset(set, 0xff, sizeof(set));
+      set['\n' >> 3] &= ~(1 << ('\n' & 7));
+      return reSet(ps, set);
+    case '*': case '+': case '?': case '{':
+      ps->err = "nothing to repeat";
+      return reEmpty(ps);
+    case '^': case '$':
+      ps->err = "^ and $ only at the ends";
+      return reEmpty(ps);
+    case '\\':
+      if (ps->p == ps->end) {
+        ps->err = "trailing \\";
+        return reEmpty(ps);
+      }
+      c = (unsigned char)*ps->p++;
+      if (reClassEscape(c, set)) return reSet(ps, set);
+      c = reEscapeByte(c);
+      if (c == -1) {
+        ps->err = "unknown escape";
+        return reEmpty(ps);
+      }
+      break;
+  }
+  reSetBit(set, c);
+  if (ps->flags & SEARCH_ICASE) reFold(set);
+  return reSet(ps, set);
+}
+
+// read the number at ps->p, -1 if there is none
+static int reNumber(struct reParser *ps) {
+  if (ps->p == ps->end || !isdigit((unsigned char)*ps->p)) return -1;
+  int n = 0;
+  while (ps->p < ps->end && isdigit((unsigned char)*ps->p)) {
+    if (n <= RE_MAX_REPEAT) n = n * 10 + *ps->p - '0';
+    ps->p++;
+  }
+  return n;
+}
+
+// an atom and the quantifiers after it
+static struct reFrag reParseRepeat(struct reParser *ps) {
+  const char *atom = ps->p;
+  struct reFrag f = reParseAtom(ps);
+  int repeated = 0;
+  while (ps->p < ps->end && !ps->err) {
+    int c = *ps->p;
+    if (c == '*' || c == '+' || c == '?') {
+      ps->p++;
+      f = reRepeat(ps, f, c == '+', c == '?');
+    } else if (c == '{') {
+      ps->p++;
+      int min = reNumber(ps), max = min;
+      if (ps->p < ps->end && *ps->p == ',') {
+        ps->p++;
+        max = reNumber(ps);
+      }
+      if (min == -1 || ps->p == ps->end || *ps->p != '}' || (max != -1 && max < min) || min > RE_MAX_REPEAT ||
+          max > RE_MAX_REPEAT || repeated) {
+        ps->err = repeated ? "repeat of a repeat" : "bad {m,n}";
+        return f;
+      }
+      ps->p++;
+      // {m,n} is the atom m times, then n - m optional copies (or a star for {m,}), each copy parsed again
+      const char *after = ps->p;
+      int have = 1;
+      if (min == 0) {
+        f = reEmpty(ps);
+        have = 0;
+      }
+      int copies = max == -1 ? min + 1 : max;
+      for (int i = have; i < copies && !ps->err; i++) {
+        ps->p = atom;
+        struct reFrag copy = reParseAtom(ps);
+        if (i >= min) copy = reRepeat(ps, copy, 0, max != -1);
+        f = reConcat(ps, f, copy);
+      }
+      ps->p = after;
+    } else {
+      break;
+    }
+    repeated = 1;
+  }
+  return f;
+}
+
+static struct reFrag reParseConcat(struct reParser *ps) {
+  struct reFrag f = {-1, -1};
+  while (ps->p < ps->end && *ps->p != '|' && *ps->p != ')' && !ps->err) {
+    struct reFrag g = reParseRepeat(ps);
+    f = f.start == -1 ? g : reConcat(ps, f, g);
+  }
+  return f.start == -1 ? reEmpty(ps) : f;
+}
+
+static struct reFrag reParseAlt(struct reParser *ps) {
+  struct reFrag f = reParseConcat(ps);
+  while (ps->p < ps->end && *ps->p == '|' && !ps->err) {
+    ps->p++;
+    f = reAlt(ps, f, reParseConcat(ps));
+  }
+  return f;
+}
+
+static const char *reCompileNfa(struct reNfa *nfa, const char *p, const char *end, int flags, int reverse) {
+  struct reParser ps = {p, end, flags, reverse, nfa, NULL};
+  struct reFrag f = reParseAlt(&ps);
+  if (!ps.err && ps.p != ps.end) ps.err = "unmatched )";
+  int m = reNew(&ps, RE_MATCH);
+  rePatch(nfa, f.out, m);
+  nfa->start = f.start;
+  return ps.err;
+}
+
+// the literal text every match starts with, scanning the pattern up to the first thing that isn't a plain byte
+static int rePrefix(const char *p, const char *end, char *out) {
+  // a | outside of brackets means the alternatives don't share a prefix
+  int depth = 0;
+  for (const char *q = p; q < end; q++) {
+    if (*q == '\\') q++;
+    else if (*q == '(') depth++;
+    else if (*q == ')') depth--;
+    else if (*q == '|' && depth == 0) return 0;
+    else if (*q == '[') {
+      for (q++; q < end && (*q != ']' || q[-1] == '['); q++)
+        if (*q == '\\') q++;
+    }
+  }
+  int n = 0;
+  while (p < end && n < RE_MAX_PREFIX) {
+    int c = (unsigned char)*p;
+    const char *next = p + 1;
+    if (c == '\\') {
+      if (next == end || isalnum((unsigned char)*next)) break;
+      c = (unsigned char)*next++;
+    } else if (strchr(".[()|*+?{^$", c)) {
+      break;
+    }
+    // a quantifier after the byte makes it optional, + makes it required once but what follows is unknown
+    if (next < end && strchr("*?{", *next)) break;
+    out[n++] = c;
+    p = next;
+    if (p < end && *p == '+') break;
+  }
+  return n;
+}
+
+/*** regex: lazy DFA ***/
+
+static void reDfaInit(struct reDfa *d, struct reNfa *nfa, int unanchored) {
+  memset(d, 0, sizeof(*d));
+  d->nfa = nfa;
+  d->unanchored = unanchored;
+  d->start = -1;
+  d->mark = calloc(nfa->n, sizeof(int));
+  d->stack = malloc(sizeof(int) * (2 * nfa->n + 1)); // every state is expanded once and pushes at most two
+  d->list = malloc(sizeof(int) * nfa->n);
+  if (d->mark == NULL || d->stack == NULL || d->list == NULL) die("malloc");
+}
+
+static void reDfaFlush(struct reDfa *d) {
+  for (int i = 0; i < d->n; i++) {
+    free(d->states[i]->set);
+    free(d->states[i]);
+  }
+  d->n = 0;
+  d->start = -1;
+  for (int i = 0; i < d->hashCap; i++) d->hash[i] = -1;
+}
+
+static void reDfaFree(struct reDfa *d) {
+  reDfaFlush(d);
+  free(d->states);
+  free(d->next);
+  free(d->code);
+  free(d->hash);
+  free(d->mark);
+  free(d->stack);
+  free(d->list);
+}
+
+// add NFA state s and everything reachable from it without consuming a byte to d->list
+static void reClosure(struct reDfa *d, int s) {
+  int sp = 0;
+  d->stack[sp++] = s;
+  while (sp > 0) {
+    s = d->stack[--sp];
+    if (s < 0 || d->mark[s] == d->gen) continue;
+    d->mark[s] = d->gen;
+    struct reState *st = &d->nfa->s[s];
+    if (st->type == RE_SPLIT) {
+      d->stack[sp++] = st->out[1];
+      d->stack[sp++] = st->out[0];
+    } else if (st->type == RE_EPS) {
+      d->stack[sp++] = st->out[0];
+    } else {
+      d->list[d->nlist++] = s;
+    }
+  }
+}
+
+static int reCompareInt(const void *a, const void *b) {
+  return *(const int *)a - *(const int *)b;
+}
+
+static unsigned int reHash(const int *set, int n) {
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < n; i++) h = (h ^ (unsigned int)set[i]) * 16777619u;
+  return h;
+}
+
+// the DFA state for the NFA states in d->list, made if it doesn't exist yet
+static int reDState(struct reDfa *d) {
+  qsort(d->list, d->nlist, sizeof(int), reCompareInt);
+  if (d->hashCap < 2 * KILO_REGEX_STATES) {
+    d->hashCap = 2 * KILO_REGEX_STATES;
+    d->hash = malloc(sizeof(int) * d->hashCap);
+    d->states = malloc(sizeof(struct reDState *) * KILO_REGEX_STATES);
+    d->next = malloc(sizeof(int) * 256 * KILO_REGEX_STATES);
+    d->code = malloc(sizeof(int) * KILO_REGEX_STATES);
+    if (d->hash == NULL || d->states == NULL || d->next == NULL || d->code == NULL) die("malloc");
+    for (int i = 0; i < d->hashCap; i++) d->hash[i] = -1;
+  }
+  if (d->n == KILO_REGEX_STATES) {
+    // the cache is full, start it over
+    reDfaFlush(d);
+    d->flushes++;
+  }
+  unsigned int h = reHash(d->list, d->nlist) & (d->hashCap - 1);
+  while (d->hash[h] != -1) {
+    struct reDState *ds = d->states[d->hash[h]];
+    if (ds->n == d->nlist && memcmp(ds->set, d->list, sizeof(int) * ds->n) == 0) return d->code[d->hash[h]];
+    h = (h + 1) & (d->hashCap - 1);
+  }
+  struct reDState *ds = malloc(sizeof(struct reDState));
+  if (ds == NULL) die("malloc");
+  ds->set = malloc(sizeof(int) * (d->nlist ? d->nlist : 1));
+  if (ds->set == NULL) die("malloc");
+  memcpy(ds->set, d->list, sizeof(int) * d->nlist);
+  ds->n = d->nlist;
+  int code = d->n;
+  for (int i = 0; i < ds->n; i++) {
+    if (d->nfa->s[ds->set[i]].type == RE_MATCH) code |= RE_ACCEPT;
+  }
+  if (ds->n == 0 && !d->unanchored) code |= RE_DEAD;
+  for (int c = 0; c < 256; c++) d->next[d->n * 256 + c] = -1;
+  d->states[d->n] = ds;
+  d->code[d->n] = code;
+  d->hash[h] = d->n++;
+  return code;
+}
+
+static int reNext(struct reDfa *d, int s, int c);
+
+// the DFA state before any byte is read
+static int reStartState(struct reDfa *d) {
+  d->gen++;
+  d->nlist = 0;
+  reClosure(d, d->nfa->start);
+  return reDState(d);
+}
+
+static int reStart(struct reDfa *d) {
+  if (d->start == -1) {
+    d->start = reStartState(d);
+    // an unanchored search sits in the start state until it sees a byte a match can begin with,
+    // when that is a single byte ('E' for (ERROR).*) memchr can jump straight to it
+    d->skip = -1;
+    if (d->unanchored) {
+      int flushes = d->flushes, escapes = 0, skip = -1;
+      for (int c = 0; c < 256 && d->flushes == flushes; c++) {
+        if (reNext(d, d->start, c) != d->start) {
+          escapes++;
+          skip = c;
+        }
+      }
+      // a cache too small to hold the start state and its neighbours flushed it, go without the skip
+      if (d->flushes != flushes) d->start = reStartState(d);
+      else if (escapes == 1) d->skip = skip;
+    }
+  }
+  return d->start;
+}
+
+// the state after byte c from state s, built the first time it is needed
+static int reStep(struct reDfa *d, int s, int c) {
+  s &= RE_ID;
+  d->gen++;
+  d->nlist = 0;
+  struct reDState *ds = d->states[s];
+  for (int i = 0; i < ds->n; i++) {
+    struct reState *st = &d->nfa->s[ds->set[i]];
+    if (st->type == RE_SET && reHasBit(st->set, c)) reClosure(d, st->out[0]);
+  }
+  if (d->unanchored) reClosure(d, d->nfa->start);
+  int flushes = d->flushes;
+  int t = reDState(d);
+  // after a flush s is gone, the transition is simply not cached
+  if (d->flushes == flushes) d->next[s * 256 + c] = t;
+  return t;
+}
+
+// the state after byte c from state s
+static inline int reNext(struct reDfa *d, int s, int c) {
+  int t = d->next[(s & RE_ID) * 256 + c];
+  return t >= 0 ? t : reStep(d, s, c);
+}
+
+/*** regex: matching ***/
+
+// end of the longest match that starts at s, -1 if none does
+static long reLongest(struct regex *re, const char *buf, size_t len, size_t s) {
+  struct reDfa *d = &re->match;
+  int st = reStart(d);
+  long last = (st & RE_ACCEPT) && (!re->anchorEnd || s == len) ? (long)s : -1;
+  for (size_t i = s; i < len; i++) {
+    st = reNext(d, st, (unsigned char)buf[i]);
+    if (st & RE_DEAD) break;
+    if ((st & RE_ACCEPT) && (!re->anchorEnd || i + 1 == len)) last = i + 1;
+  }
+  return last;
+}
+
+// is there any match that starts at from or later
+static int reAny(struct regex *re, const char *buf, size_t len, size_t from) {
+  struct reDfa *d = &re->search;
+  int st = reStart(d);
+  if (re->anchorEnd) {
+    for (size_t i = from; i < len; i++) st = reNext(d, st, (unsigned char)buf[i]);
+    return (st & RE_ACCEPT) != 0;
+  }
+  for (size_t i = from; i < len && !(st & RE_ACCEPT); i++) {
+    if (st == d->start && d->skip != -1) {
+      const char *p = memchr(buf + i, d->skip, len - i);
+      if (p == NULL) break;
+      i = p - buf;
+    }
+    st = reNext(d, st, (unsigned char)buf[i]);
+  }
+  return (st & RE_ACCEPT) != 0;
+}
+
+// mark in re->starts every position of buf a match starts at, with one pass of the reverse DFA from the end
+static void reStarts(struct regex *re, const char *buf, size_t len) {
+  if (re->startsCap < len + 1) {
+    re->startsCap = len + 1;
+    free(re->starts);
+    re->starts = malloc(re->startsCap);
+    if (re->starts == NULL) die("malloc");
+  }
+  memset(re->starts, 0, len + 1);
+  struct reDfa *d = &re->back;
+  int st = reStart(d);
+  re->starts[len] = (st & RE_ACCEPT) != 0;
+  for (size_t i = len; i > 0; i--) {
+    st = reNext(d, st, (unsigned char)buf[i - 1]);
+    if (st & RE_DEAD) break;
+    re->starts[i - 1] = (st & RE_ACCEPT) != 0;
+  }
+  re->startsBuf = buf;
+  re->startsLen = len;
+}
+
+static int reWordChar(unsigned char c) {
+  return isalnum(c) || c == '_';
+}
+
+// does the match [s, e) pass the whole word check, if there is one
+static int reWordOk(struct regex *re, const char *buf, size_t len, size_t s, size_t e) {
+  if (!(re->flags & SEARCH_WORD)) return 1;
+  return (s == 0 || !reWordChar(buf[s - 1])) && (e == len || !reWordChar(buf[e]));
+}
+
+// compile pattern, flags are SEARCH_ICASE and SEARCH_WORD. On a syntax error returns NULL and sets *err
+struct regex *regexCompile(const char *pattern, int flags, const char **err) {
+  struct regex *re = calloc(1, sizeof(struct regex));
+  if (re == NULL) die("calloc");
+  re->flags = flags;
+  const char *p = pattern, *end = pattern + strlen(pattern);
+  if (p < end && *p == '^') {
+    re->anchorStart = 1;
+    p++;
+  }
+  if (end > p && end[-1] == '$') {
+    // unless the $ is escaped, an odd number of backslashes before it
+    int backslashes = 0;
+    for (const char *q = end - 2; q >= p && *q == '\\'; q--) backslashes++;
+    if (backslashes % 2 == 0) {
+      re->anchorEnd = 1;
+      end--;
+    }
+  }
+  *err = reCompileNfa(&re->fwd, p, end, flags, 0);
+  if (*err == NULL) *err = reCompileNfa(&re->rev, p, end, flags, 1);
+  if (*err) {
+    free(re->fwd.s);
+    free(re->rev.s);
+    free(re);
+    return NULL;
+  }
+  re->plen = rePrefix(p, end, re->prefix);
+  reDfaInit(&re->search, &re->fwd, 1);
+  reDfaInit(&re->match, &re->fwd, 0);
+  reDfaInit(&re->back, &re->rev, !re->anchorEnd);
+  return re;
+}
+
+void regexFree(struct regex *re) {
+  if (re == NULL) return;
+  reDfaFree(&re->search);
+  reDfaFree(&re->match);
+  reDfaFree(&re->back);
+  free(re->fwd.s);
+  free(re->rev.s);
+  free(re->starts);
+  free(re);
+}
+
+// the literal text every match starts with, *len is 0 when there is none
+const char *regexPrefix(struct regex *re, int *len) {
+  *len = re->plen;
+  return re->prefix;
+}
+
+// find the leftmost-longest non-empty match that starts at from or later, returns its start and sets *end,
+// or returns -1. To step through the matches of a buffer call again with from = *end: the starts found by
+// the reverse pass are kept for the buffer, so the whole buffer costs one pass whatever the number of matches
+long regexFind(struct regex *re, const char *buf, size_t len, size_t from, size_t *end) {
+  if (from > len) return -1;
+  if (re->anchorStart) {
+    if (from > 0) return -1;
+    long e = reLongest(re, buf, len, 0);
+    if (e <= 0 || !reWordOk(re, buf, len, 0, e)) return -1;
+    *end = e;
+    return 0;
+  }
+  if (re->plen > 0) {
+    // every match starts with the prefix, only the places it occurs can start one
+    int tflags = re->flags & SEARCH_ICASE;
+    for (long s = textSearch(buf, len, from, re->prefix, re->plen, tflags); s != -1;
+         s = textSearch(buf, len, s + 1, re->prefix, re->plen, tflags)) {
+      long e = reLongest(re, buf, len, s);
+      if (e > s && reWordOk(re, buf, len, s, e)) {
+        *end = e;
+        return s;
+      }
+    }
+    return -1;
+  }
+  if (from == 0 || re->startsBuf != buf || re->startsLen != len) {
+    if (!reAny(re, buf, len, from)) return -1;
+    reStarts(re, buf, len);
+  }
+  for (size_t s = from; s < len; s++) {
+    if (!re->starts[s]) continue;
+    long e = reLongest(re, buf, len, s);
+    if (e > (long)s && reWordOk(re, buf, len, s, e)) {
+      *end = e;
+      return s;
+    }
+  }
+  return -1;
+}
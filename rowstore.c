@@ -0,0 +1,605 @@
+#include "kilo.h"
+
+/*** row store ***/
+/*
+The row store keeps the editor rows in a rope of small chunks instead of one flat array.
+Every node of the rope is a treap node (a binary search tree ordered by row position and
+heap ordered by a random priority) that owns a chunk of up to RS_CHUNK rows.
+Each node also remembers how many rows live in its whole subtree, so we can find the
+chunk holding row N by walking down from the root, which takes O(log n).
+Inserting or deleting a row only moves the rows inside one chunk, and a full chunk is
+split in two, so Enter and Backspace cost the same on a 1K line file and a 10M line file.
+A snapshot (rsSnapshot()) freezes the treap as it is: from then on a change to a node made before the snapshot
+goes to a copy of it instead, and the nodes above it are copied too (path copying), so the snapshot keeps seeing
+the old tree while the live one moves on. Only what is changed gets copied, a chunk at a time. The rows of a copied
+chunk get their own text as well, see editorRowUnshare(). Nodes only the snapshot still uses are freed by rsRelease().
+A file opened with --max-resident is indexed into pages instead of rows (rsAppendPage()): a node that stands for
+up to KILO_PAGE_ROWS rows of the mapped file and only knows where their text is, so the treap is a sparse line
+index with one entry per page. The first lookup of a row in a page makes its rows (rsAt() pages it in), in place,
+the tree doesn't change shape. rsTrim() pages out the pages looked up least recently when they take too much
+memory, unless an edit is in them. rsEach() hands the rows of a page that is out to the visitor made up on the
+fly, so searching and saving a paged file never page it in. A page that is about to change shape (a row
+inserted or deleted in it) becomes ordinary chunks first, those stay in memory like any edited text.
+*/
+
+typedef struct rsNode {
+  struct rsNode *left;
+  struct rsNode *right;
+  unsigned int prio; // random priority that keeps the treap balanced
+  int total; // number of rows in this subtree
+  int n; // number of rows held by this node
+  erow *rows; // RS_CHUNK slots, the first n are in use, a page has n slots and NULL while it is paged out
+  char *base; // a page: where the text of its rows is in the mapping, NULL for a chunk
+  size_t len; // a page: bytes of text, line endings included
+  unsigned long used; // a page: rs->clock when it was last looked up
+  int epoch; // epoch of the store when the node was made, nodes up to rs->frozen belong to a snapshot
+  int retired; // 1 when the live tree no longer uses the node, only the snapshot does
+} rsNode;
+
+// xorshift generator for the node priorities, deterministic so runs are reproducible
+static unsigned int rsRandom() {
+  static unsigned int state = 2463534242u;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static int rsTotal(rsNode *t) {
+  return t ? t->total : 0;
+}
+
+// recompute the subtree row count after the children of t changed
+static void rsPull(rsNode *t) {
+  t->total = rsTotal(t->left) + t->n + rsTotal(t->right);
+}
+
+// a new node with room for cap rows, 0 for a page that is out
+static rsNode *rsNewNode(struct rowStore *rs, int cap) {
+  rsNode *t = malloc(sizeof(rsNode));
+  if (t == NULL) die("malloc");
+  t->rows = NULL;
+  if (cap > 0) {
+    t->rows = malloc(sizeof(erow) * cap);
+    if (t->rows == NULL) die("malloc");
+  }
+  t->base = NULL;
+  t->len = 0;
+  t->used = 0;
+  t->left = t->right = NULL;
+  t->prio = rsRandom();
+  t->total = 0;
+  t->n = 0;
+  t->epoch = rs->epoch;
+  t->retired = 0;
+  return t;
+}
+
+static int rsFrozen(struct rowStore *rs, rsNode *t) {
+  return t->epoch <= rs->frozen;
+}
+
+// memory a page that is in takes: its rows, and the text they point at
+static size_t rsPageCost(rsNode *t) {
+  return sizeof(erow) * t->n + t->len;
+}
+
+// free a node the live tree let go of, unless a snapshot still holds it
+static void rsFreeNode(struct rowStore *rs, rsNode *t) {
+  if (t->base && t->rows) rs->resident -= rsPageCost(t);
+  if (rsFrozen(rs, t)) {
+    t->retired = 1;
+    return;
+  }
+  free(t->rows);
+  free(t);
+}
+
+// return a node of the live tree that can be changed: t itself, or a copy of it when t belongs to a snapshot
+// the copy is complete before the caller links it in, a reader of the snapshot never sees it
+static rsNode *rsOwn(struct rowStore *rs, rsNode *t) {
+  if (t == NULL || !rsFrozen(rs, t)) return t;
+  rsNode *u = rsNewNode(rs, t->base ? (t->rows ? t->n : 0) : RS_CHUNK);
+  u->left = t->left;
+  u->right = t->right;
+  u->prio = t->prio;
+  u->total = t->total;
+  u->n = t->n;
+  u->base = t->base;
+  u->len = t->len;
+  u->used = t->used;
+  if (t->rows) {
+    memcpy(u->rows, t->rows, sizeof(erow) * t->n);
+    for (int i = 0; i < u->n; i++) editorRowUnshare(&u->rows[i]);
+  }
+  t->retired = 1;
+  return u;
+}
+
+// join two treaps, every row of a comes before every row of b
+static rsNode *rsMerge(struct rowStore *rs, rsNode *a, rsNode *b) {
+  if (a == NULL) return b;
+  if (b == NULL) return a;
+  if (a->prio > b->prio) {
+    a = rsOwn(rs, a);
+    a->right = rsMerge(rs, a->right, b);
+    rsPull(a);
+    return a;
+  }
+  b = rsOwn(rs, b);
+  b->left = rsMerge(rs, a, b->left);
+  rsPull(b);
+  return b;
+}
+
+// cut a treap in two, *l gets the first k rows and *r the rest
+// k must fall on a chunk boundary, rows inside a chunk are never separated here
+static void rsSplit(struct rowStore *rs, rsNode *t, int k, rsNode **l, rsNode **r) {
+  if (t == NULL) {
+    *l = *r = NULL;
+    return;
+  }
+  t = rsOwn(rs, t);
+  int lt = rsTotal(t->left);
+  if (k <= lt) {
+    rsSplit(rs, t->left, k, l, &t->left);
+    rsPull(t);
+    *r = t;
+  } else {
+    rsSplit(rs, t->right, k - lt - t->n, &t->right, r);
+    rsPull(t);
+    *l = t;
+  }
+}
+
+// find the chunk that holds row *at, on return *at is the index inside that chunk
+static rsNode *rsFind(rsNode *t, int *at) {
+  while (t) {
+    int lt = rsTotal(t->left);
+    if (*at < lt) {
+      t = t->left;
+    } else if (*at < lt + t->n) {
+      *at -= lt;
+      return t;
+    } else {
+      *at -= lt + t->n;
+      t = t->right;
+    }
+  }
+  return NULL;
+}
+
+// link the live tree's own copy u of the node at *p in. Search workers walk the live tree while the main thread
+// draws, and drawing under a snapshot copies the nodes it looks at: the release store publishes u complete, and
+// a node that didn't need a copy is not written at all
+static rsNode *rsRelink(rsNode **p, rsNode *u) {
+  if (u != *p) __atomic_store_n(p, u, __ATOMIC_RELEASE);
+  return u;
+}
+
+// rsFind() for a change: the chunk and every node above it are made the live tree's own on the way down
+static rsNode *rsFindOwn(struct rowStore *rs, int *at) {
+  rsNode **p = &rs->root;
+  while (*p) {
+    rsNode *t = rsRelink(p, rsOwn(rs, *p));
+    int lt = rsTotal(t->left);
+    if (*at < lt) {
+      p = &t->left;
+    } else if (*at < lt + t->n) {
+      *at -= lt;
+      return t;
+    } else {
+      *at -= lt + t->n;
+      p = &t->right;
+    }
+  }
+  return NULL;
+}
+
+// walk from the root towards the chunk starting at row start and add delta to every subtree count on the way
+static void rsAdjust(struct rowStore *rs, int start, int delta) {
+  rsNode **p = &rs->root;
+  while (*p) {
+    rsNode *t = rsRelink(p, rsOwn(rs, *p));
+    int lt = rsTotal(t->left);
+    t->total += delta;
+    if (start < lt) {
+      p = &t->left;
+    } else if (start < lt + t->n || t->right == NULL) {
+      return;
+    } else {
+      start -= lt + t->n;
+      p = &t->right;
+    }
+  }
+}
+
+// take the chunk that starts at row start out of the treap and return it, *before and *after keep the other rows
+static rsNode *rsDetach(struct rowStore *rs, int start, int n, rsNode **before, rsNode **after) {
+  rsNode *mid;
+  rsSplit(rs, rs->root, start, before, &mid);
+  rsSplit(rs, mid, n, &mid, after);
+  return rsOwn(rs, mid);
+}
+
+// make the rows of a page that is out, from the text in the mapping
+static void rsPageIn(struct rowStore *rs, rsNode *t) {
+  erow *rows = malloc(sizeof(erow) * t->n);
+  if (rows == NULL) die("malloc");
+  const char *p = t->base;
+  editorPageRows(&p, t->base + t->len, rows, t->n);
+  rs->resident += rsPageCost(t);
+  // a search worker may be walking the page right now, it sees either no rows or all of them
+  __atomic_store_n(&t->rows, rows, __ATOMIC_RELEASE);
+}
+
+static rsNode *rsBuildRows(struct rowStore *rs, erow *rows, int n);
+
+// the page that starts at row start is about to change shape, make it ordinary chunks
+static void rsUnpage(struct rowStore *rs, int start, rsNode *t) {
+  rsNode *before, *after;
+  rsNode *mid = rsDetach(rs, start, t->n, &before, &after);
+  if (mid->rows == NULL) rsPageIn(rs, mid);
+  rsNode *chunks = rsBuildRows(rs, mid->rows, mid->n);
+  rsFreeNode(rs, mid); // the rows moved to the chunks
+  rs->root = rsMerge(rs, rsMerge(rs, before, chunks), after);
+  rs->finger = NULL;
+}
+
+void rsInit(struct rowStore *rs) {
+  rs->root = NULL;
+  rs->finger = NULL;
+  rs->fingerStart = 0;
+  rs->epoch = 0;
+  rs->frozen = -1;
+  rs->resident = rs->trimmed = 0;
+  rs->clock = 0;
+}
+
+int rsCount(struct rowStore *rs) {
+  return rsTotal(rs->root);
+}
+
+// return the row at index at, or NULL if there is no such row
+erow *rsAt(struct rowStore *rs, int at) {
+  // most callers walk the rows in order, so try the chunk we used last time before searching the tree
+  rsNode *f = rs->finger;
+  if (f && at >= rs->fingerStart && at < rs->fingerStart + f->n)
+    return &f->rows[at - rs->fingerStart];
+  if (at < 0 || at >= rsTotal(rs->root)) return NULL;
+  int off = at;
+  f = rsFindOwn(rs, &off); // the caller may change the row
+  if (f->base) {
+    if (f->rows == NULL) rsPageIn(rs, f);
+    f->used = ++rs->clock;
+  }
+  rs->finger = f;
+  rs->fingerStart = at - off;
+  return &f->rows[off];
+}
+
+// rsWalk() of a page that is out: its rows are made RS_CHUNK at a time on the stack, flagged ROW_PAGED.
+// A visitor that points all of them somewhere else (editorRemapRows() after a save) moves the page there
+static int rsWalkPage(rsNode *t, int skip, int first, rsVisitFn fn, void *arg) {
+  erow tmp[RS_CHUNK];
+  const char *p = t->base, *end = t->base + t->len;
+  char *moved = NULL;
+  size_t len = 0;
+  for (int done = 0; done < t->n;) {
+    int want = t->n - done < RS_CHUNK ? t->n - done : RS_CHUNK;
+    int m = editorPageRows(&p, end, tmp, want);
+    if (m == 0) break;
+    for (int i = 0; i < m; i++) tmp[i].flags |= ROW_PAGED;
+    char *was = tmp[0].chars;
+    int from = done < skip ? (skip - done < m ? skip - done : m) : 0;
+    if (from < m && !fn(tmp + from, m - from, first + done + from, arg)) return 0;
+    if (done == 0 && skip == 0 && tmp[0].chars != was) moved = tmp[0].chars;
+    for (int i = 0; i < m; i++) len += tmp[i].size + 1;
+    done += m;
+  }
+  if (moved) {
+    // only the main thread moves rows, a worker's walk never gets here
+    t->base = moved;
+    t->len = len;
+  }
+  return 1;
+}
+
+// the links are read with acquire loads, they pair with rsRelink() when the walk is on a worker thread
+static int rsWalk(rsNode *t, int at, int start, rsVisitFn fn, void *arg) {
+  if (t == NULL) return 1;
+  rsNode *left = __atomic_load_n(&t->left, __ATOMIC_ACQUIRE);
+  int lt = rsTotal(left);
+  if (at < start + lt && !rsWalk(left, at, start, fn, arg)) return 0;
+  int first = start + lt;
+  if (at < first + t->n) {
+    int skip = at > first ? at - first : 0;
+    erow *rows = __atomic_load_n(&t->rows, __ATOMIC_ACQUIRE);
+    if (rows == NULL) {
+      if (!rsWalkPage(t, skip, first, fn, arg)) return 0;
+    } else if (!fn(rows + skip, t->n - skip, first + skip, arg)) {
+      return 0;
+    }
+  }
+  return rsWalk(__atomic_load_n(&t->right, __ATOMIC_ACQUIRE), at, first + t->n, fn, arg);
+}
+
+// call fn on the rows from index at to the end, a chunk at a time: fn gets an array of n consecutive rows
+// and the index of the first one, and returns 0 to stop early
+// visiting every chunk once is much cheaper than looking up each row, which walks down from the root
+// whenever it leaves the finger chunk
+void rsEach(struct rowStore *rs, int at, rsVisitFn fn, void *arg) {
+  rsWalk(__atomic_load_n(&rs->root, __ATOMIC_ACQUIRE), at < 0 ? 0 : at, 0, fn, arg);
+}
+
+// open an empty slot at index at and return it, the caller fills in the row
+erow *rsInsert(struct rowStore *rs, int at) {
+  int count = rsTotal(rs->root);
+  if (at < 0 || at > count) return NULL;
+  rs->finger = NULL;
+
+  if (rs->root == NULL) {
+    rs->root = rsNewNode(rs, RS_CHUNK);
+    rs->root->n = rs->root->total = 1;
+    return &rs->root->rows[0];
+  }
+
+  // appending goes to the last chunk, anything else to the chunk holding the row we push down
+  int off = at;
+  rsNode *t;
+  if (at == count) {
+    off = at - 1;
+    t = rsFindOwn(rs, &off);
+    off++;
+  } else {
+    t = rsFindOwn(rs, &off);
+  }
+  int start = at - off;
+  if (t->base) {
+    rsUnpage(rs, start, t);
+    return rsInsert(rs, at);
+  }
+
+  if (t->n == RS_CHUNK) {
+    // the chunk is full, move its upper half into a new chunk placed right after it
+    rsNode *before, *after;
+    t = rsDetach(rs, start, t->n, &before, &after);
+    int half = RS_CHUNK / 2;
+    rsNode *u = rsNewNode(rs, RS_CHUNK);
+    u->n = t->n - half;
+    memcpy(u->rows, &t->rows[half], sizeof(erow) * u->n);
+    t->n = half;
+    rsPull(t);
+    rsPull(u);
+    rs->root = rsMerge(rs, rsMerge(rs, before, rsMerge(rs, t, u)), after);
+    if (off > half) {
+      t = u;
+      start += half;
+      off -= half;
+    }
+  }
+
+  rsAdjust(rs, start, 1);
+  memmove(&t->rows[off + 1], &t->rows[off], sizeof(erow) * (t->n - off));
+  t->n++;
+  return &t->rows[off];
+}
+
+// remove the slot at index at, the caller has already released what the row owned
+void rsDelete(struct rowStore *rs, int at) {
+  if (at < 0 || at >= rsTotal(rs->root)) return;
+  rs->finger = NULL;
+  int off = at;
+  rsNode *t = rsFindOwn(rs, &off);
+  int start = at - off;
+  if (t->base) {
+    rsUnpage(rs, start, t);
+    rsDelete(rs, at);
+    return;
+  }
+
+  if (t->n == 1) {
+    // the chunk would become empty, drop it from the treap
+    rsNode *before, *after;
+    rsFreeNode(rs, rsDetach(rs, start, 1, &before, &after));
+    rs->root = rsMerge(rs, before, after);
+    return;
+  }
+  rsAdjust(rs, start, -1);
+  memmove(&t->rows[off], &t->rows[off + 1], sizeof(erow) * (t->n - off - 1));
+  t->n--;
+}
+
+static int rsComparePrio(const void *a, const void *b) {
+  unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// build a perfectly balanced treap over nodes[lo, hi)
+static rsNode *rsBuild(rsNode **nodes, int lo, int hi) {
+  if (lo >= hi) return NULL;
+  int mid = lo + (hi - lo) / 2;
+  rsNode *t = nodes[mid];
+  t->left = rsBuild(nodes, lo, mid);
+  t->right = rsBuild(nodes, mid + 1, hi);
+  rsPull(t);
+  return t;
+}
+
+// build a treap over n rows in O(n) instead of n separate inserts
+// the rows are packed into full chunks, built into a balanced treap and given heap ordered priorities
+static rsNode *rsBuildRows(struct rowStore *rs, erow *rows, int n) {
+  int m = (n + RS_CHUNK - 1) / RS_CHUNK;
+  rsNode **nodes = malloc(sizeof(rsNode *) * m);
+  unsigned int *prio = malloc(sizeof(unsigned int) * m);
+  if (nodes == NULL || prio == NULL) die("malloc");
+  for (int i = 0; i < m; i++) {
+    nodes[i] = rsNewNode(rs, RS_CHUNK);
+    nodes[i]->n = (i == m - 1) ? n - i * RS_CHUNK : RS_CHUNK;
+    memcpy(nodes[i]->rows, &rows[i * RS_CHUNK], sizeof(erow) * nodes[i]->n);
+    prio[i] = rsRandom();
+  }
+  rsNode *t = rsBuild(nodes, 0, m);
+
+  // hand out the random priorities largest first in breadth first order, so the heap order holds
+  qsort(prio, m, sizeof(unsigned int), rsComparePrio);
+  int head = 0, tail = 0;
+  nodes[tail++] = t;
+  while (head < tail) {
+    rsNode *u = nodes[head];
+    u->prio = prio[head++];
+    if (u->left) nodes[tail++] = u->left;
+    if (u->right) nodes[tail++] = u->right;
+  }
+  free(nodes);
+  free(prio);
+  return t;
+}
+
+// make row at the first row of a chunk, cutting the chunk that holds it in two if needed
+static void rsCut(struct rowStore *rs, int at) {
+  if (at <= 0 || at >= rsTotal(rs->root)) return;
+  int off = at;
+  rsNode *t = rsFind(rs->root, &off);
+  if (off == 0) return;
+  rsNode *before, *after;
+  int start = at - off;
+  if (t->base) {
+    rsUnpage(rs, start, t);
+    rsCut(rs, at);
+    return;
+  }
+  t = rsDetach(rs, start, t->n, &before, &after);
+  rsNode *u = rsNewNode(rs, RS_CHUNK);
+  u->n = t->n - off;
+  memcpy(u->rows, &t->rows[off], sizeof(erow) * u->n);
+  t->n = off;
+  rsPull(t);
+  rsPull(u);
+  rs->root = rsMerge(rs, rsMerge(rs, before, rsMerge(rs, t, u)), after);
+}
+
+// insert n rows before index at in one operation, the rows are copied into the store
+void rsInsertRows(struct rowStore *rs, int at, erow *rows, int n) {
+  int count = rsTotal(rs->root);
+  if (n <= 0 || at < 0 || at > count) return;
+  rs->finger = NULL;
+  // at may fall inside a chunk, cut the chunk in two so the new rows can go between the halves
+  rsCut(rs, at);
+  rsNode *l, *r;
+  rsSplit(rs, rs->root, at, &l, &r);
+  rs->root = rsMerge(rs, rsMerge(rs, l, rsBuildRows(rs, rows, n)), r);
+}
+
+static void rsFreeTree(struct rowStore *rs, rsNode *t);
+
+// remove rows [at, at + n) in one operation, the caller has already released what the rows owned
+void rsDeleteRows(struct rowStore *rs, int at, int n) {
+  int count = rsTotal(rs->root);
+  if (at < 0 || n <= 0 || at >= count) return;
+  if (n > count - at) n = count - at;
+  rs->finger = NULL;
+  rsCut(rs, at);
+  rsCut(rs, at + n);
+  rsNode *before, *after;
+  rsFreeTree(rs, rsDetach(rs, at, n, &before, &after));
+  rs->root = rsMerge(rs, before, after);
+}
+
+// append n rows at the end of the store
+void rsAppendRows(struct rowStore *rs, erow *rows, int n) {
+  rsInsertRows(rs, rsTotal(rs->root), rows, n);
+}
+
+static void rsFreeTree(struct rowStore *rs, rsNode *t) {
+  if (t == NULL) return;
+  rsFreeTree(rs, t->left);
+  rsFreeTree(rs, t->right);
+  rsFreeNode(rs, t);
+}
+
+// release the chunks, the rows themselves must be freed by the caller first
+void rsFree(struct rowStore *rs) {
+  rsFreeTree(rs, rs->root);
+  rsInit(rs);
+}
+
+// freeze the rows as they are now into snap, a read-only store that rsEach() can walk from any thread
+// while the live store goes on changing. There is one snapshot at a time, rsRelease() ends it
+void rsSnapshot(struct rowStore *rs, struct rowStore *snap) {
+  rsInit(snap);
+  snap->root = rs->root;
+  rs->frozen = rs->epoch++;
+  rs->finger = NULL;
+}
+
+// free the nodes a retired node leads to that the live tree no longer uses, a node still in use
+// is shared with the snapshot together with everything below it
+static void rsReleaseTree(rsNode *t) {
+  if (t == NULL || !t->retired) return;
+  rsReleaseTree(t->left);
+  rsReleaseTree(t->right);
+  free(t->rows);
+  free(t);
+}
+
+// end the snapshot: free the nodes only it was using, the live store stops copying
+void rsRelease(struct rowStore *rs, struct rowStore *snap) {
+  rsReleaseTree(snap->root);
+  rsInit(snap);
+  rs->frozen = -1;
+}
+
+// add a page of n rows, len bytes of the mapping starting at base, at the end of the store, it starts out paged out
+void rsAppendPage(struct rowStore *rs, char *base, size_t len, int n) {
+  if (n <= 0) return;
+  rsNode *t = rsNewNode(rs, 0);
+  t->base = base;
+  t->len = len;
+  t->n = t->total = n;
+  rs->root = rsMerge(rs, rs->root, t);
+  rs->finger = NULL;
+}
+
+// collect the pages that are in, for rsTrim()
+static void rsPagesIn(rsNode *t, rsNode ***list, int *n, int *cap) {
+  if (t == NULL) return;
+  rsPagesIn(t->left, list, n, cap);
+  if (t->base && t->rows) {
+    if (*n == *cap) {
+      *cap = *cap ? *cap * 2 : 256;
+      *list = realloc(*list, sizeof(rsNode *) * *cap);
+      if (*list == NULL) die("realloc");
+    }
+    (*list)[(*n)++] = t;
+  }
+  rsPagesIn(t->right, list, n, cap);
+}
+
+static int rsCompareUsed(const void *a, const void *b) {
+  unsigned long x = (*(rsNode *const *)a)->used, y = (*(rsNode *const *)b)->used;
+  return x < y ? -1 : x > y;
+}
+
+// page out the pages looked up least recently until those still in take no more than 3/4 of budget bytes, so the
+// next trim is a while away. A page with an edit in it stays (editorPageOut() says so). Nothing may be holding a
+// row, or walking the store on another thread: called between frames, never during a snapshot
+void rsTrim(struct rowStore *rs, size_t budget) {
+  // pages that stay in because of their edits don't make every frame look for something to page out
+  if (rs->resident <= budget || rs->resident <= rs->trimmed || rs->frozen != -1) return;
+  rsNode **list = NULL;
+  int n = 0, cap = 0;
+  rsPagesIn(rs->root, &list, &n, &cap);
+  qsort(list, n, sizeof(rsNode *), rsCompareUsed);
+  for (int i = 0; i < n && rs->resident > budget / 4 * 3; i++) {
+    rsNode *t = list[i];
+    size_t cost = rsPageCost(t);
+    if (!editorPageOut(t->rows, t->n, &t->base, &t->len)) continue;
+    free(t->rows);
+    t->rows = NULL;
+    rs->resident -= cost;
+  }
+  free(list);
+  rs->finger = NULL;
+  rs->trimmed = rs->resident;
+}
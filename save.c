@@ -0,0 +1,503 @@
+#include "kilo.h"
+#include <sys/uio.h>
+
+/*** save ***/
+/*
+Saving never builds the file in memory.
+A row that was not edited still points into the mapping of the file, at the offset it had when the file was read.
+If it will be written at that same offset it is already on disk, so the rows themselves tell what changed.
+When only a few ranges of rows changed (at most KILO_SAVE_PATCHES ranges, KILO_SAVE_PATCH_MAX bytes and half the file),
+and the file on disk is still the one that was mapped, the save seeks to each of those ranges and writes it
+in place, then truncates or extends the file. That covers same-length edits anywhere and edits near the end of the file.
+A patch is not atomic: a crash in the middle of one leaves part of it on disk.
+Anything else is written in full: the rows are streamed straight from where they live (the mapping or the arena)
+with writev(), a batch of up to KILO_SAVE_IOV pieces or KILO_SAVE_BATCH bytes per call, into a temporary file
+next to the target. Unedited rows are still in the mapping one after another, newlines included, so a run of
+them is one piece. The temporary file is fsync'd and then renamed over the target, so a crash leaves either the
+old file or the new one, never half of each.
+The full write runs on a background thread while editing goes on. It writes a snapshot of the row store
+(rsSnapshot()), which costs nothing to take: the live rows copy a chunk only when it is changed during the save.
+The thread wakes the main loop as it goes, the status bar shows how far it got, and once it is done
+editorSavePoll() releases the snapshot. If nothing was edited in the meantime the rows are then pointed at the
+new file and the buffer is clean, otherwise it stays modified by the edits made during the save.
+A patch is small and made right away, the patched rows are pointed back into the mapping of the file.
+A target that is not a regular file (a device, a fifo) can't be replaced by a rename, it is written in place.
+*/
+
+static const char saveNewline = '\n';
+
+struct saveBatch {
+  int fd;
+  struct iovec iov[KILO_SAVE_IOV];
+  int n;
+  size_t bytes; // bytes in the batch
+  size_t written; // bytes written so far
+  int rows; // rows left to add, the walk stops at 0
+  char *mapEnd; // end of the mapping, a mapped row's newline is only there when the row ends before it
+  int err; // errno of a failed write, 0 while everything went fine
+  int report; // 1 on the background thread, the bytes written go to bgsave.written
+};
+
+// a range of rows that changed, written at off in the file
+struct savePatch {
+  int row, nrows;
+  size_t off, len;
+};
+
+static struct {
+  struct savePatch *list;
+  int n;
+  size_t bytes; // bytes in all the ranges
+  size_t off; // where the next row goes in the file
+  int fits; // 0 once the changes are too many to patch
+} patch;
+
+// the background save
+static struct {
+  pthread_t tid;
+  int running; // a save was started and editorSavePoll() has not finished it yet
+  int done; // set by the thread when it is finished
+  struct rowStore snap; // the rows as they were when the save started
+  char *target; // the file replaced
+  struct stat old; // the file before the save, the new one gets its mode and owner
+  int exists;
+  size_t written, total; // progress, total is 0 until the thread measured the snapshot
+  long lastWake; // when the thread last woke the main loop
+  int err; // errno when the save failed, 0 when it went fine
+  int fd; // the new file, the rows get mapped from it once the save is done
+  int dirty; // E.dirty when the save started
+  size_t journal; // editorJournalMark() when the save started, the edits after it are not in the new file
+  long start;
+} bgsave;
+
+// write out the batch, writev may write less than asked so keep going from where it stopped
+static void saveFlush(struct saveBatch *b) {
+  struct iovec *iov = b->iov;
+  int n = b->n;
+  while (n > 0 && b->err == 0) {
+    ssize_t w = writev(b->fd, iov, n);
+    if (w == -1) {
+      if (errno != EINTR) b->err = errno;
+      continue;
+    }
+    b->written += w;
+    if (b->report) {
+      __atomic_store_n(&bgsave.written, b->written, __ATOMIC_RELAXED);
+      // wake the main loop to show the progress, not more often than the screen is drawn
+      long now = editorNow();
+      if (now - bgsave.lastWake >= 1000000 / KILO_MAX_FPS) {
+        bgsave.lastWake = now;
+        editorWake();
+      }
+    }
+    while (n > 0 && (size_t)w >= iov->iov_len) {
+      w -= iov->iov_len;
+      iov++;
+      n--;
+    }
+    if (n > 0) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= w;
+    }
+  }
+  b->n = 0;
+  b->bytes = 0;
+}
+
+static void saveAdd(struct saveBatch *b, const char *p, size_t len) {
+  if (len == 0) return;
+  // continues the last piece, true for rows that are next to each other in the mapping
+  if (b->n > 0 && (char *)b->iov[b->n - 1].iov_base + b->iov[b->n - 1].iov_len == p) {
+    b->iov[b->n - 1].iov_len += len;
+  } else {
+    if (b->n == KILO_SAVE_IOV) saveFlush(b);
+    b->iov[b->n].iov_base = (char *)p;
+    b->iov[b->n].iov_len = len;
+    b->n++;
+  }
+  b->bytes += len;
+  if (b->bytes >= KILO_SAVE_BATCH) saveFlush(b);
+}
+
+// rsEach visitor: add the text and the newline of n rows to the batch
+static int saveRows(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  struct saveBatch *b = arg;
+  for (int i = 0; i < n && b->rows > 0 && b->err == 0; i++, b->rows--) {
+    erow *row = &rows[i];
+    struct rowExt *ext = row->ext;
+    if (ext && ext->gapLen) {
+      // a long row being edited, the text is on both sides of the gap
+      saveAdd(b, row->chars, ext->gapStart);
+      saveAdd(b, row->chars + ext->gapStart + ext->gapLen, row->size - ext->gapStart);
+    } else if ((row->flags & ROW_MAPPED) && row->chars + row->size < b->mapEnd && row->chars[row->size] == '\n') {
+      // the newline that follows the row in the mapping goes too, so the next unedited row continues this piece
+      saveAdd(b, row->chars, row->size + 1);
+      continue;
+    } else {
+      saveAdd(b, row->chars, row->size);
+    }
+    saveAdd(b, &saveNewline, 1);
+  }
+  return b->rows > 0 && b->err == 0;
+}
+
+// NULL when there is no memory for it, the save thread can't die()
+static struct saveBatch *saveBatchNew(int fd) {
+  struct saveBatch *b = malloc(sizeof(struct saveBatch));
+  if (b == NULL) return NULL;
+  b->fd = fd;
+  b->n = 0;
+  b->bytes = b->written = 0;
+  b->rows = INT_MAX;
+  b->mapEnd = E.map ? E.map + E.mapsize : NULL;
+  b->err = 0;
+  b->report = 0;
+  return b;
+}
+
+// write every row of rs to fd, returns the number of bytes written or -1 with errno set
+static ssize_t saveWriteRows(struct rowStore *rs, int fd, int report) {
+  struct saveBatch *b = saveBatchNew(fd);
+  if (b == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+  b->report = report;
+  rsEach(rs, 0, saveRows, b);
+  saveFlush(b);
+  ssize_t written = b->err ? -1 : (ssize_t)b->written;
+  if (b->err) errno = b->err;
+  free(b);
+  return written;
+}
+
+// rsEach visitor: find the rows that are not on disk where they will be written, and list them as ranges
+static int saveDiff(erow *rows, int n, int start, void *arg) {
+  (void)arg;
+  for (int i = 0; i < n; i++) {
+    erow *row = &rows[i];
+    size_t off = patch.off;
+    patch.off += row->size + 1;
+    if ((row->flags & ROW_MAPPED) && row->chars == E.map + off && patch.off <= E.mapsize &&
+        row->chars[row->size] == '\n')
+      continue;
+    // a row of a page that is out can't be given its own copy before the patch writes over its text
+    if (row->flags & ROW_PAGED) return patch.fits = 0;
+    struct savePatch *last = patch.n ? &patch.list[patch.n - 1] : NULL;
+    if (last && last->row + last->nrows == start + i) {
+      last->nrows++;
+      last->len += row->size + 1;
+    } else {
+      if (patch.n == KILO_SAVE_PATCHES) return patch.fits = 0;
+      patch.list[patch.n++] = (struct savePatch){start + i, 1, off, row->size + 1};
+    }
+    patch.bytes += row->size + 1;
+    if (patch.bytes > KILO_SAVE_PATCH_MAX) return patch.fits = 0;
+  }
+  return 1;
+}
+
+// fsync the directory holding path, so the rename is on disk too
+static void saveSyncDir(const char *path) {
+  char *slash = strrchr(path, '/');
+  char *dir = slash ? strndup(path, slash == path ? 1 : slash - path) : strdup(".");
+  if (dir == NULL) return; // called on the save thread, the rename is done, it only isn't synced yet
+  int fd = open(dir, O_RDONLY);
+  if (fd != -1) {
+    fsync(fd);
+    close(fd);
+  }
+  free(dir);
+}
+
+// point the rows at the file fd now holds, len bytes long
+static void saveRemap(int fd, size_t len) {
+  char *map = len > 0 ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  // the old file was renamed over but not changed, its mapping still holds the text, so the rows can stay
+  if (map == MAP_FAILED) return;
+  editorRemapRows(map, len);
+  fstat(fd, &E.mapstat);
+}
+
+// rsEach visitor: give the rows of a range their own copy of the text, the patch may write over where it was
+static int saveDetach(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  int *left = arg;
+  for (int i = 0; i < n && *left > 0; i++, (*left)--) editorRowMaterialize(&rows[i]);
+  return *left > 0;
+}
+
+// rsEach visitor: point the rows of a range back into the mapping, once the patch put their text there
+struct saveAttach {
+  int left;
+  char *p;
+};
+
+static int saveAttach(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  struct saveAttach *a = arg;
+  for (int i = 0; i < n && a->left > 0; i++, a->left--) {
+    editorRemapRow(&rows[i], a->p);
+    a->p += rows[i].size + 1;
+  }
+  return a->left > 0;
+}
+
+// patch the changed ranges of the file in place, returns the bytes written, -1 on error,
+// or -2 when the file can't be patched and has to be written in full
+static ssize_t savePatch(const char *target, struct stat *st, int *ranges) {
+  if (E.map == NULL || E.mapheap || st->st_dev != E.mapstat.st_dev || st->st_ino != E.mapstat.st_ino ||
+      st->st_size != E.mapstat.st_size || st->st_mtim.tv_sec != E.mapstat.st_mtim.tv_sec ||
+      st->st_mtim.tv_nsec != E.mapstat.st_mtim.tv_nsec || (size_t)st->st_size != E.mapsize)
+    return -2; // it changed on disk since it was mapped
+  editorIndexTo(INT_MAX);
+  patch.list = malloc(sizeof(struct savePatch) * KILO_SAVE_PATCHES);
+  if (patch.list == NULL) die("malloc");
+  patch.n = 0;
+  patch.bytes = patch.off = 0;
+  patch.fits = 1;
+  rsEach(&E.rows, 0, saveDiff, NULL);
+  size_t len = patch.off;
+  // a patch of more than half the file saves little over writing it all, and gives up the atomic rename for it
+  if (patch.bytes > len / 2) patch.fits = 0;
+  int fd = patch.fits ? open(target, O_RDWR) : -1;
+  // when the size changes, map the file as it will be before touching it, if that fails it is written in full instead.
+  // The same size keeps the mapping, no row was copied into it so it shows what the patch writes
+  int same = len == E.mapsize;
+  char *map = fd == -1 || len == 0 || same ? NULL : mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (fd == -1 || map == MAP_FAILED) {
+    if (fd != -1) close(fd);
+    free(patch.list);
+    return -2;
+  }
+  *ranges = patch.n;
+  // a changed row may still point into this file where the patch writes (a row moved by an edit before it),
+  // so the rows of the ranges get their own copy first, and a failed patch leaves them as they were
+  for (int i = 0; i < patch.n; i++) {
+    int left = patch.list[i].nrows;
+    rsEach(&E.rows, patch.list[i].row, saveDetach, &left);
+  }
+  struct saveBatch *b = saveBatchNew(fd);
+  if (b == NULL) die("malloc");
+  b->mapEnd = NULL;
+  for (int i = 0; i < patch.n && b->err == 0; i++) {
+    if (lseek(fd, patch.list[i].off, SEEK_SET) == -1) {
+      b->err = errno;
+      break;
+    }
+    b->rows = patch.list[i].nrows;
+    rsEach(&E.rows, patch.list[i].row, saveRows, b);
+    saveFlush(b);
+  }
+  int err = b->err;
+  ssize_t written = b->written;
+  free(b);
+  if (err == 0 && !same && ftruncate(fd, len) == -1) err = errno;
+  if (err == 0 && fdatasync(fd) == -1) err = errno;
+  if (err) {
+    if (map) munmap(map, len);
+    close(fd);
+    free(patch.list);
+    errno = err;
+    return -1;
+  }
+  if (same) {
+    // only the rows of the ranges have their own copy, every other row already points at its text
+    for (int i = 0; i < patch.n; i++) {
+      struct saveAttach a = {patch.list[i].nrows, E.map + patch.list[i].off};
+      rsEach(&E.rows, patch.list[i].row, saveAttach, &a);
+    }
+  } else if (map) {
+    editorRemapRows(map, len);
+  } else {
+    editorUnmapFile();
+    E.mapsize = E.indexed = 0;
+  }
+  free(patch.list);
+  fstat(fd, &E.mapstat);
+  close(fd);
+  return written;
+}
+
+// rsEach visitor: add up the bytes n rows take in the file
+static int saveMeasure(erow *rows, int n, int start, void *arg) {
+  (void)start;
+  size_t *total = arg;
+  for (int i = 0; i < n; i++) *total += rows[i].size + 1;
+  return 1;
+}
+
+// the background thread: write the snapshot to a new file next to the target and rename it over the target
+static void *saveWorker(void *arg) {
+  (void)arg;
+  size_t total = 0;
+  rsEach(&bgsave.snap, 0, saveMeasure, &total);
+  __atomic_store_n(&bgsave.total, total, __ATOMIC_RELAXED);
+  // .name.XXXXXX in the same directory, a rename only works within one file system
+  const char *target = bgsave.target;
+  const char *slash = strrchr(target, '/');
+  int dirlen = slash ? slash - target + 1 : 0;
+  size_t size = strlen(target) + 9;
+  char *tmp = malloc(size);
+  int fd = -1;
+  if (tmp == NULL) {
+    // the thread can't die(), saveFinish() says the file couldn't be saved
+    errno = ENOMEM;
+  } else {
+    snprintf(tmp, size, "%.*s.%s.XXXXXX", dirlen, target, target + dirlen);
+    fd = mkstemp(tmp);
+  }
+  if (fd != -1) {
+    // the new file keeps the permissions (and the owner, when we may) of the old one
+    if (bgsave.exists) {
+      fchmod(fd, bgsave.old.st_mode & 07777);
+      if (fchown(fd, bgsave.old.st_uid, bgsave.old.st_gid) == -1) {} // not our file, it stays ours
+    } else {
+      fchmod(fd, 0644);
+    }
+    if (saveWriteRows(&bgsave.snap, fd, 1) == -1 || fsync(fd) == -1 || rename(tmp, target) == -1) {
+      bgsave.err = errno;
+      close(fd);
+      unlink(tmp);
+      fd = -1;
+    } else {
+      saveSyncDir(target);
+    }
+  } else {
+    bgsave.err = errno;
+  }
+  free(tmp);
+  bgsave.fd = fd;
+  __atomic_store_n(&bgsave.done, 1, __ATOMIC_RELEASE);
+  editorWake();
+  return NULL;
+}
+
+// start writing the whole file to target on the background thread
+static void saveStart(const char *target, struct stat *old) {
+  editorIndexTo(INT_MAX); // every row of the file has to be written
+  bgsave.target = strdup(target);
+  if (bgsave.target == NULL) die("strdup");
+  bgsave.exists = old != NULL;
+  if (old) bgsave.old = *old;
+  bgsave.written = bgsave.total = 0;
+  bgsave.err = 0;
+  bgsave.fd = -1;
+  bgsave.done = 0;
+  bgsave.dirty = E.dirty;
+  bgsave.journal = editorJournalMark();
+  bgsave.start = editorNow();
+  bgsave.lastWake = bgsave.start;
+  rsSnapshot(&E.rows, &bgsave.snap);
+  editorWakeInit();
+  if (pthread_create(&bgsave.tid, NULL, saveWorker, NULL) != 0) die("pthread_create");
+  bgsave.running = 1;
+  editorSetStatusMessage("Saving...");
+}
+
+// the thread is done: let the snapshot go and take over the new file
+static void saveFinish() {
+  pthread_join(bgsave.tid, NULL);
+  bgsave.running = 0;
+  rsRelease(&E.rows, &bgsave.snap);
+  editorFreeUnshared();
+  free(bgsave.target);
+  long ms = (editorNow() - bgsave.start) / 1000;
+  if (bgsave.fd == -1) {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(bgsave.err));
+    return;
+  }
+  if (E.dirty == bgsave.dirty) {
+    // the rows are what was written, they move over to the new file and the old one can go
+    saveRemap(bgsave.fd, bgsave.written);
+    E.dirty = 0;
+    editorJournalReset();
+    editorFollowSaved(bgsave.written);
+    editorSetStatusMessage("%zu bytes written to disk in %ld ms", bgsave.written, ms);
+  } else {
+    // edited during the save, the rows stay on the old mapping (the old file lives on until it is unmapped)
+    E.dirty -= bgsave.dirty;
+    // the journal keeps the edits made during the save, now as edits to the new file
+    struct stat st;
+    if (fstat(bgsave.fd, &st) == 0) editorJournalRebase(bgsave.journal, &st);
+    editorFollowSaved(bgsave.written);
+    editorSetStatusMessage("%zu bytes written to disk in %ld ms, edited since", bgsave.written, ms);
+  }
+  close(bgsave.fd);
+  editorFollowKick(); // the rows are free again
+}
+
+// finish the save if the thread is done with it, returns 1 if it did. Search workers may be reading the rows the
+// new mapping replaces, then it waits for the wakeup of the last one. A wakeup that went elsewhere is not needed,
+// every caller looks at bgsave.done itself
+static int saveReap() {
+  if (!bgsave.running || !__atomic_load_n(&bgsave.done, __ATOMIC_ACQUIRE) || !editorFindIdle()) return 0;
+  saveFinish();
+  return 1;
+}
+
+// called when the main loop or a prompt is woken: show how far the background save got, or finish it
+void editorSavePoll() {
+  if (!bgsave.running || saveReap()) return;
+  if (__atomic_load_n(&bgsave.done, __ATOMIC_ACQUIRE)) return;
+  size_t total = __atomic_load_n(&bgsave.total, __ATOMIC_RELAXED);
+  size_t written = __atomic_load_n(&bgsave.written, __ATOMIC_RELAXED);
+  if (total > 0) editorSetStatusMessage("Saving... %d%%", (int)(written * 100 / total));
+}
+
+// wait for the background save to finish, before quitting or throwing the rows away
+void editorSaveWait() {
+  if (bgsave.running) saveFinish();
+}
+
+// 1 while the background thread writes a snapshot of the rows
+int editorSaving() {
+  saveReap();
+  return bgsave.running;
+}
+
+void editorSave() {
+  saveReap();
+  if (bgsave.running) {
+    editorSetStatusMessage("Still saving, wait for it to finish");
+    return;
+  }
+  if (E.filename == NULL) {
+    E.filename = editorPrompt("Save as:%s (ESC to cancel) ", NULL);
+    if (E.filename == NULL) {
+      editorSetStatusMessage("Save aborted");
+      return;
+    }
+  }
+  long t0 = editorNow();
+  struct stat st;
+  int exists = stat(E.filename, &st) == 0;
+  ssize_t written = -2;
+  int ranges = -1;
+  if (exists && !S_ISREG(st.st_mode)) {
+    int fd = open(E.filename, O_WRONLY | O_TRUNC);
+    editorIndexTo(INT_MAX);
+    written = fd == -1 ? -1 : saveWriteRows(&E.rows, fd, 0);
+    if (fd != -1) close(fd);
+  } else {
+    // a symlink stays a symlink, the file it points at is the one replaced
+    char *target = exists ? realpath(E.filename, NULL) : NULL;
+    if (target) written = savePatch(target, &st, &ranges);
+    if (written < 0) saveStart(target ? target : E.filename, exists ? &st : NULL);
+    free(target);
+    if (written < 0) return;
+  }
+  if (written == -1) {
+    editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno));
+    return;
+  }
+  E.dirty = 0;
+  editorJournalReset();
+  editorFollowSaved(E.mapstat.st_size);
+  long ms = (editorNow() - t0) / 1000;
+  if (ranges >= 0)
+    editorSetStatusMessage("%zd bytes written to disk in %ld ms, %d ranges patched", written, ms, ranges);
+  else
+    editorSetStatusMessage("%zd bytes written to disk in %ld ms", written, ms);
+}
@@ -0,0 +1,788 @@
+#include "kilo.h"
+
+/*** find ***/
+/*
+Incremental search keeps a table of every match of the query, sorted by row and column.
+When the query grows by a key, each match of the new query starts where a match of the old one did,
+so instead of scanning the file again we only check the old matches and keep those that still match.
+The arrows step through the table and the prompt shows "match 37 of 1,204".
+Only a query that gets shorter or changes in the middle scans the whole file again, and that scan runs in the
+background (see below), the prompt keeps taking keys and the screen keeps moving while it runs.
+Ctrl-C toggles matching either case and Ctrl-W whole words only, the rows are searched with textSearch().
+Ctrl-R makes the query a regular expression (see regex.c). A regex is always searched from scratch, with
+its literal prefix, when it has one, standing in for the query in the fast block search.
+A query that matches more than KILO_MATCH_MAX times (a single common letter) doesn't get a table,
+the arrows then fall back to scanning the rows from the current match like before.
+Ctrl-E replaces every match, see editorReplaceAll().
+*/
+
+struct match {
+  int row;
+  int col; // offset in the row's chars
+};
+
+static struct {
+  struct match *list;
+  int n;
+  int cap;
+  char *query; // the query the table was built for
+  int qlen;
+  int overflow; // 1 when the query has more than KILO_MATCH_MAX matches and the table was dropped
+  int nomem; // the table was dropped like that because the matches did not fit in memory
+  int current; // index in the table of the match under the cursor, -1 for none
+  int row, col; // match under the cursor when there is no table
+  struct regex *re; // the compiled query in regex mode
+  const char *reErr; // why the query doesn't compile, NULL if it does
+  int running; // 1 while the workers build the table, it is in the tasks until they are all done
+  int jumped; // 1 once the cursor went to a match of the query
+  int originRow, originCol; // where the cursor was when the prompt opened, the search goes on from there
+  int replaced; // matches the last Ctrl-E replaced, shown in the prompt until the query changes
+} find;
+
+static int findFlags = 0; // SEARCH_ICASE, SEARCH_WORD and SEARCH_REGEX, kept from one search to the next
+
+static char findPrompt[160] = "Search: %s (Use ESC/Arrows/Enter)"; // room for the longest info with every % doubled
+
+static void findCancel();
+static void findCollect();
+
+static void findReset() {
+  findCancel();
+  free(find.list);
+  free(find.query);
+  regexFree(find.re);
+  memset(&find, 0, sizeof(find));
+}
+
+// rows straight from the mapped file that were next to each other there, with only a line ending between them
+// (cap is 0 only for mapped rows, the flags can't be used here since drawing changes them while the workers read)
+static int findAdjacent(erow *a, erow *b) {
+  if (a->cap != 0 || b->cap != 0) return 0;
+  char *end = a->chars + a->size;
+  long gap = b->chars - end;
+  return (gap == 1 && end[0] == '\n') || (gap == 2 && end[0] == '\r' && end[1] == '\n');
+}
+
+/*** background search ***/
+/*
+A new query is searched by a pool of E.threads worker threads (--threads), the main thread only hands out the work
+and picks up the results. The rows are cut into tasks of KILO_FIND_TASK rows, each with its own list of matches,
+and the workers take the tasks starting with the one under the cursor, so the matches on the screen and right after it
+come back first and the cursor can jump to the next match before the rest of the file is searched.
+When a task is done the worker writes a byte to the wake pipe of the input layer, editorReadKey() turns that into a
+WAKE_EVENT key and the prompt calls us with it, so the results are taken in between the user's keys and the prompt
+shows how far the search got. Once every task is done their lists are joined into the table.
+A key that changes the query cancels the search: the workers drop what they are doing at the next chunk of rows.
+While the workers run the main thread only draws. The workers read the row store and the text of the rows but
+never the fields drawing changes, and leave the rows long enough to have a gap (see editorRowCloseGap()) to the
+main thread, which closes the gap before searching them.
+*/
+
+struct findTask {
+  int start, n; // the rows of the task
+  struct match *list; // its matches, in order
+  int count, cap;
+  int *defer; // long rows left to the main thread
+  int ndefer, deferCap;
+  int done; // set by the worker that searched it, under findLock
+  int ready; // done as the main thread last saw it
+  int merged; // set by the main thread once the deferred rows are searched too
+  int failed; // a list could not grow, the task stopped there
+};
+
+static pthread_mutex_t findLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t findWork = PTHREAD_COND_INITIALIZER; // the workers wait here for a search
+static pthread_cond_t findIdle = PTHREAD_COND_INITIALIZER; // the main thread waits here for tasks to finish
+
+struct findScanArg {
+  const char *needle; // the query, or the literal every regex match starts with, NULL when a regex has none
+  int nlen;
+  int flags; // textSearch() flags for the needle
+  struct regex *re; // the regex, each thread has its own since a regex caches its DFA states as it runs
+  struct findTask *task; // where the matches go
+  int end; // one past the last row to search
+};
+
+static struct {
+  pthread_t tids[KILO_MAX_THREADS];
+  int nthreads; // workers started, 0 until the first search
+  int quit; // tells the workers to exit
+  struct findTask *tasks; // the search being run, set by the main thread while no worker is busy
+  int ntasks;
+  int first; // task handed out first, the one holding the row the search started from
+  int next; // tasks handed out
+  int busy; // workers searching a task
+  int done; // tasks finished
+  int cancel; // the search was dropped, read without the lock by the workers
+  int gen; // counts the searches, a worker compiles the regex again when it changes
+  struct findScanArg scan; // what to look for, re is NULL here
+  const char *pattern; // the query of a regex search, NULL for a plain one
+  int reflags;
+  int total; // matches found so far, over max the search stops
+  int max;
+} bg;
+
+// more than bg.max matches were found, the workers stop
+static int findOverflowed() {
+  return __atomic_load_n(&bg.total, __ATOMIC_RELAXED) > bg.max;
+}
+
+// add a match to the task, returns 0 when there are too many to keep
+static int findAdd(struct findScanArg *a, int row, int col) {
+  if (__atomic_add_fetch(&bg.total, 1, __ATOMIC_RELAXED) > bg.max) return 0;
+  struct findTask *t = a->task;
+  if (t->count == t->cap) {
+    // a worker can't die(), the main thread sees failed in findCollect()
+    int cap = t->cap ? t->cap * 2 : 256;
+    struct match *list = realloc(t->list, sizeof(struct match) * cap);
+    if (list == NULL) {
+      t->failed = 1;
+      return 0;
+    }
+    t->list = list;
+    t->cap = cap;
+  }
+  t->list[t->count].row = row;
+  t->list[t->count].col = col;
+  t->count++;
+  return 1;
+}
+
+// add the regex matches of one row
+static int findAddRegex(struct findScanArg *a, erow *row, int at) {
+  size_t end = 0;
+  for (long m = regexFind(a->re, row->chars, row->size, 0, &end); m != -1;
+       m = regexFind(a->re, row->chars, row->size, end, &end)) {
+    if (!findAdd(a, at, m)) return 0;
+  }
+  return 1;
+}
+
+// add the matches of one row with contiguous text
+static int findScanRow(struct findScanArg *a, erow *row, int at) {
+  if (a->re) return findAddRegex(a, row, at);
+  for (long m = -1; (m = textSearch(row->chars, row->size, m + 1, a->needle, a->nlen, a->flags)) != -1;) {
+    if (!findAdd(a, at, m)) return 0;
+  }
+  return 1;
+}
+
+// leave a row to the main thread, returns 0 when there is no memory for it
+static int findDefer(struct findTask *t, int row) {
+  if (t->ndefer == t->deferCap) {
+    int cap = t->deferCap ? t->deferCap * 2 : 16;
+    int *defer = realloc(t->defer, sizeof(int) * cap);
+    if (defer == NULL) {
+      t->failed = 1;
+      return 0;
+    }
+    t->defer = defer;
+    t->deferCap = cap;
+  }
+  t->defer[t->ndefer++] = row;
+  return 1;
+}
+
+// add the matches in n consecutive rows, the first of them is row start, called by rsEach() in a worker
+static int findScanRows(erow *rows, int n, int start, void *arg) {
+  struct findScanArg *a = arg;
+  if (__atomic_load_n(&bg.cancel, __ATOMIC_RELAXED)) return 0;
+  if (start + n > a->end) n = a->end - start;
+  for (int k = 0; k < n;) {
+    if (rows[k].cap >= KILO_GAP_MIN) {
+      // only a row this long can have a gap, and closing it writes to the row
+      if (!findDefer(a->task, start + k)) return 0;
+      k++;
+      continue;
+    }
+    if (a->needle == NULL) {
+      // nothing to look for first, every row goes through the regex
+      if (!findAddRegex(a, &rows[k], start + k)) return 0;
+      k++;
+      continue;
+    }
+    // a run of rows that are one block in the mapped file is searched with one call, the query holds no
+    // line ending so a match never spans two rows, and a line ending is not a word character
+    int j = k + 1;
+    while (j < n && findAdjacent(&rows[j - 1], &rows[j])) j++;
+    char *base = rows[k].chars;
+    size_t len = rows[j - 1].chars + rows[j - 1].size - base;
+    int r = k;
+    long m = -1;
+    // matches may overlap, "aa" is twice in "aaa"
+    while ((m = textSearch(base, len, m + 1, a->needle, a->nlen, a->flags)) != -1) {
+      while (base + m >= rows[r].chars + rows[r].size) r++;
+      if (a->re == NULL) {
+        if (!findAdd(a, start + r, base + m - rows[r].chars)) return 0;
+      } else {
+        // the prefix is in row r, so a regex match may be too, take them all and go on from the next row
+        if (!findAddRegex(a, &rows[r], start + r)) return 0;
+        m = rows[r].chars + rows[r].size - base;
+      }
+    }
+    k = j;
+  }
+  return start + n < a->end;
+}
+
+static void *findWorker(void *arg) {
+  (void)arg;
+  struct regex *re = NULL;
+  int gen = -1;
+  pthread_mutex_lock(&findLock);
+  while (1) {
+    while (!bg.quit && (bg.cancel || bg.next == bg.ntasks || findOverflowed()))
+      pthread_cond_wait(&findWork, &findLock);
+    if (bg.quit) break;
+    struct findTask *t = &bg.tasks[(bg.first + bg.next++) % bg.ntasks];
+    bg.busy++;
+    struct findScanArg a = bg.scan;
+    if (gen != bg.gen) {
+      // the pattern compiled before, so it compiles again
+      const char *err;
+      regexFree(re);
+      re = bg.pattern ? regexCompile(bg.pattern, bg.reflags, &err) : NULL;
+      gen = bg.gen;
+    }
+    pthread_mutex_unlock(&findLock);
+
+    a.re = re;
+    a.task = t;
+    a.end = t->start + t->n;
+    rsEach(&E.rows, t->start, findScanRows, &a);
+
+    pthread_mutex_lock(&findLock);
+    bg.busy--;
+    if (!bg.cancel) {
+      t->done = 1;
+      bg.done++;
+    }
+    pthread_cond_broadcast(&findIdle);
+    editorWake();
+  }
+  pthread_mutex_unlock(&findLock);
+  regexFree(re);
+  return NULL;
+}
+
+// make sure there are E.threads workers waiting
+static void findPoolStart() {
+  int want = E.threads > 1 ? E.threads : 1;
+  if (bg.nthreads == want) return;
+  if (bg.nthreads > 0) {
+    // --threads changed (only the benchmarks do that), start over with the new count
+    pthread_mutex_lock(&findLock);
+    bg.quit = 1;
+    pthread_cond_broadcast(&findWork);
+    pthread_mutex_unlock(&findLock);
+    for (int i = 0; i < bg.nthreads; i++) pthread_join(bg.tids[i], NULL);
+    bg.quit = 0;
+  }
+  editorWakeInit();
+  textSearchName(); // picks the search kernel, so the workers don't all race to do it on their first call
+  for (int i = 0; i < want; i++) {
+    if (pthread_create(&bg.tids[i], NULL, findWorker, NULL) != 0) die("pthread_create");
+  }
+  bg.nthreads = want;
+}
+
+// 1 when no worker is walking the rows or about to start, so the main thread may page rows out
+int editorFindIdle() {
+  pthread_mutex_lock(&findLock);
+  int idle = bg.busy == 0 && (bg.cancel || bg.next == bg.ntasks || findOverflowed());
+  pthread_mutex_unlock(&findLock);
+  return idle;
+}
+
+// drop the search the workers are running, and wait until none of them looks at the rows any more
+static void findCancel() {
+  if (bg.tasks == NULL) return;
+  pthread_mutex_lock(&findLock);
+  __atomic_store_n(&bg.cancel, 1, __ATOMIC_RELAXED);
+  while (bg.busy > 0) pthread_cond_wait(&findIdle, &findLock);
+  pthread_mutex_unlock(&findLock);
+  for (int i = 0; i < bg.ntasks; i++) {
+    free(bg.tasks[i].list);
+    free(bg.tasks[i].defer);
+  }
+  free(bg.tasks);
+  bg.tasks = NULL;
+  bg.ntasks = 0;
+  find.running = 0;
+  editorFollowKick(); // the rows are free again, and no worker is going to say so
+}
+
+// start the workers on the table for find.query, with no more than max matches
+static void findStart(int max) {
+  findPoolStart();
+  struct findScanArg a = {find.query, find.qlen, findFlags & (SEARCH_ICASE | SEARCH_WORD), NULL, NULL, 0};
+  if (find.re) {
+    a.needle = regexPrefix(find.re, &a.nlen);
+    if (a.nlen == 0) a.needle = NULL;
+    a.flags = findFlags & SEARCH_ICASE;
+  }
+  int ntasks = (E.numrows + KILO_FIND_TASK - 1) / KILO_FIND_TASK;
+  struct findTask *tasks = calloc(ntasks ? ntasks : 1, sizeof(struct findTask));
+  if (tasks == NULL) die("calloc");
+  for (int i = 0; i < ntasks; i++) {
+    tasks[i].start = i * KILO_FIND_TASK;
+    tasks[i].n = i < ntasks - 1 ? KILO_FIND_TASK : E.numrows - tasks[i].start;
+  }
+  find.n = 0;
+  find.overflow = find.nomem = 0;
+  find.running = 1;
+  pthread_mutex_lock(&findLock);
+  bg.tasks = tasks;
+  bg.ntasks = ntasks;
+  bg.first = find.originRow < E.numrows ? find.originRow / KILO_FIND_TASK : 0;
+  bg.next = 0;
+  bg.done = 0;
+  __atomic_store_n(&bg.cancel, 0, __ATOMIC_RELAXED);
+  bg.gen++;
+  bg.scan = a;
+  bg.pattern = find.re ? find.query : NULL;
+  bg.reflags = findFlags & (SEARCH_ICASE | SEARCH_WORD);
+  __atomic_store_n(&bg.total, 0, __ATOMIC_RELAXED);
+  bg.max = max;
+  pthread_cond_broadcast(&findWork);
+  pthread_mutex_unlock(&findLock);
+  // an empty file has no tasks, so no worker will tell us it is done
+  if (ntasks == 0) findCollect();
+}
+
+static int findCompare(const struct match *a, int row, int col) {
+  return a->row != row ? (a->row < row ? -1 : 1) : (a->col < col ? -1 : a->col > col);
+}
+
+// index of the first match in list that is not before row, col
+static int findLowerBound(struct match *list, int n, int row, int col) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (findCompare(&list[mid], row, col) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// search the rows a worker left to us and merge their matches into the task's list
+static int findMergeDeferred(struct findTask *t) {
+  if (t->ndefer == 0) return 1;
+  struct findTask extra = {0};
+  struct findScanArg a = {find.query, find.qlen, findFlags, find.re, &extra, 0};
+  int ok = 1;
+  for (int i = 0; i < t->ndefer && ok; i++) {
+    erow *row = rsAt(&E.rows, t->defer[i]);
+    editorRowCloseGap(row);
+    ok = findScanRow(&a, row, t->defer[i]);
+  }
+  if (extra.count > 0) {
+    struct match *list = malloc(sizeof(struct match) * (t->count + extra.count));
+    if (list == NULL) die("malloc");
+    int i = 0, j = 0, k = 0;
+    while (i < t->count || j < extra.count) {
+      if (j == extra.count || (i < t->count && findCompare(&t->list[i], extra.list[j].row, extra.list[j].col) < 0))
+        list[k++] = t->list[i++];
+      else
+        list[k++] = extra.list[j++];
+    }
+    free(t->list);
+    t->list = list;
+    t->count = t->cap = k;
+  }
+  free(extra.list);
+  t->failed = extra.failed;
+  return ok;
+}
+
+// the match after (direction 1) or before (-1) row, col in the finished tasks, wrapping around the file.
+// With wait set a task still being searched ends the walk, the match could be in it. Returns 0 when there is none
+static int findStep(int direction, int *row, int *col, int wait) {
+  int n = bg.ntasks;
+  if (n == 0) return 0;
+  int home = *row < E.numrows ? *row / KILO_FIND_TASK : n - 1;
+  for (int k = 0; k <= n; k++) {
+    struct findTask *t = &bg.tasks[((home + direction * k) % n + n) % n];
+    if (!t->merged) {
+      if (wait) return 0;
+      continue;
+    }
+    if (t->count == 0) continue;
+    int i;
+    if (k == 0) {
+      // only what is past row, col in the task the walk starts in
+      i = findLowerBound(t->list, t->count, *row, *col + (direction == 1));
+      if (direction == -1) i--;
+      if (i < 0 || i >= t->count) continue;
+    } else {
+      // coming back to the first task after going around the whole file, whatever is left in it
+      i = direction == 1 ? 0 : t->count - 1;
+    }
+    *row = t->list[i].row;
+    *col = t->list[i].col;
+    return 1;
+  }
+  return 0;
+}
+
+static void findJump(int row, int col) {
+  E.cy = row;
+  E.cx = col;
+  E.rowoff = E.numrows;
+}
+
+// go to the first match from where the prompt opened on, the table has to be complete
+static void findJumpFirst() {
+  find.current = -1;
+  if (find.n == 0) return;
+  find.current = findLowerBound(find.list, find.n, find.originRow, find.originCol);
+  if (find.current == find.n) find.current = 0;
+  find.jumped = 1;
+  findJump(find.list[find.current].row, find.list[find.current].col);
+}
+
+static int findNext(int direction, int *row, int *col);
+
+// take in the tasks the workers finished, and once they all are build the table
+static void findCollect() {
+  pthread_mutex_lock(&findLock);
+  int overflow = findOverflowed();
+  int complete = bg.done == bg.ntasks;
+  for (int i = 0; i < bg.ntasks; i++) bg.tasks[i].ready = bg.tasks[i].done;
+  pthread_mutex_unlock(&findLock);
+  for (int i = 0; i < bg.ntasks && !overflow; i++) {
+    struct findTask *t = &bg.tasks[i];
+    if (t->ready && !t->merged) {
+      overflow = t->failed || !findMergeDeferred(t);
+      // the matches didn't fit in memory, the table goes as if there were too many
+      if (t->failed) find.nomem = 1;
+      t->merged = 1;
+    }
+  }
+
+  if (overflow) {
+    // too many to list, the arrows scan the rows from the match under the cursor
+    findCancel();
+    find.overflow = 1;
+    if (find.jumped) {
+      find.row = E.cy;
+      find.col = E.cx;
+      return;
+    }
+    find.row = find.originRow < E.numrows ? find.originRow : 0;
+    find.col = find.originCol - 1;
+    if (findNext(1, &find.row, &find.col)) findJump(find.row, find.col);
+    find.jumped = 1;
+    return;
+  }
+  if (!find.jumped) {
+    int row = find.originRow, col = find.originCol - 1;
+    if (findStep(1, &row, &col, 1)) {
+      find.jumped = 1;
+      findJump(row, col);
+    }
+  }
+  if (!complete) return;
+
+  // every task is in, join their lists into the table
+  int total = 0;
+  for (int i = 0; i < bg.ntasks; i++) total += bg.tasks[i].count;
+  if (total > find.cap) {
+    free(find.list);
+    find.cap = total;
+    find.list = malloc(sizeof(struct match) * find.cap);
+    if (find.list == NULL) die("malloc");
+  }
+  find.n = 0;
+  for (int i = 0; i < bg.ntasks; i++) {
+    if (bg.tasks[i].count == 0) continue;
+    memcpy(find.list + find.n, bg.tasks[i].list, sizeof(struct match) * bg.tasks[i].count);
+    find.n += bg.tasks[i].count;
+  }
+  findCancel();
+  // the cursor is on a match already, unless there is none
+  find.current = find.jumped ? findLowerBound(find.list, find.n, E.cy, E.cx) : -1;
+  if (find.current == find.n) find.current = -1;
+}
+
+// wait for the workers to finish the search and take in the results
+static void findWait() {
+  if (!find.running) return;
+  pthread_mutex_lock(&findLock);
+  while (bg.done < bg.ntasks && !(findOverflowed() && bg.busy == 0)) pthread_cond_wait(&findIdle, &findLock);
+  pthread_mutex_unlock(&findLock);
+  findCollect();
+}
+
+/*** find prompt ***/
+
+// narrow the table of a prefix of query down to the matches of query
+static void findRefine(const char *query, int qlen) {
+  int n = 0;
+  for (int i = 0; i < find.n; i++) {
+    erow *row = rsAt(&E.rows, find.list[i].row);
+    if (textMatchAt(row->chars, row->size, find.list[i].col, query, qlen, findFlags)) find.list[n++] = find.list[i];
+  }
+  find.n = n;
+}
+
+// the first match in a row at or after from, -1 if there is none, *next is where to look for the one after it
+static long findInRow(erow *r, long from, long *next) {
+  if (find.re) {
+    size_t end = 0;
+    long m = regexFind(find.re, r->chars, r->size, from, &end);
+    *next = end;
+    return m;
+  }
+  long m = textSearch(r->chars, r->size, from, find.query, find.qlen, findFlags);
+  *next = m + 1;
+  return m;
+}
+
+// first match after (before when direction is -1) the one at row, col, wrapping around the file
+static int findNext(int direction, int *row, int *col) {
+  if (E.numrows == 0) return 0;
+  int current = *row;
+  for (int i = 0; i <= E.numrows; i++) {
+    erow *r = rsAt(&E.rows, current);
+    editorRowCloseGap(r);
+    long m = -1, next = 0;
+    if (direction == 1) {
+      m = findInRow(r, i == 0 ? *col + 1 : 0, &next);
+    } else {
+      // the last match that starts before col
+      long upto = i == 0 ? *col : r->size;
+      for (long q; (q = findInRow(r, next, &next)) != -1 && q < upto;) m = q;
+    }
+    if (m != -1) {
+      *row = current;
+      *col = m;
+      return 1;
+    }
+    current += direction;
+    if (current == -1) current = E.numrows - 1;
+    else if (current == E.numrows) current = 0;
+  }
+  return 0;
+}
+
+/*** replace ***/
+
+// replace every match of the current search with rep, returns how many were replaced.
+// The matches come from the table, built by the workers without the KILO_MATCH_MAX limit when it has to be,
+// then every row with a match is rebuilt once (editorReplaceSpans()) and the whole replace is one undo step
+int editorReplaceAll(const char *rep, int rlen) {
+  if (find.qlen == 0 || find.reErr) return 0;
+  if (find.running || find.overflow) {
+    findCancel();
+    find.overflow = find.nomem = 0;
+    find.jumped = 1; // the cursor stays where it is
+    findStart(INT_MAX);
+    findWait();
+  }
+  if (find.n == 0) return 0;
+  struct replaceSpan *spans = malloc(sizeof(struct replaceSpan) * find.n);
+  if (spans == NULL) die("malloc");
+  int n = 0, end = 0;
+  erow *row = NULL;
+  for (int i = 0; i < find.n; i++) {
+    struct match *m = &find.list[i];
+    if (i == 0 || m->row != find.list[i - 1].row) {
+      row = rsAt(&E.rows, m->row);
+      editorRowCloseGap(row);
+      end = 0;
+    }
+    // the table lists overlapping matches too ("aa" twice in "aaa"), a match inside the one before stays as it is
+    if (m->col < end) continue;
+    int len = find.qlen;
+    if (find.re) {
+      size_t e = 0;
+      regexFind(find.re, row->chars, row->size, m->col, &e);
+      len = e - m->col;
+    }
+    spans[n].row = m->row;
+    spans[n].col = m->col;
+    spans[n].len = len;
+    spans[n].text = rep;
+    spans[n].tlen = rlen;
+    end = m->col + len;
+    n++;
+  }
+  editorRecordReplace(spans, n, rep, rlen);
+  editorReplaceSpans(spans, n);
+  E.cy = spans[0].row;
+  E.cx = spans[0].col;
+  free(spans);
+  // the table is for the text before the replace, search again
+  find.n = 0;
+  find.current = -1;
+  find.jumped = 1;
+  findStart(KILO_MATCH_MAX);
+  return n;
+}
+
+// Ctrl-E in the search prompt: ask for the replacement and replace every match
+static void findReplacePrompt() {
+  if (find.qlen == 0 || find.reErr) return;
+  char *rep = editorPrompt("Replace every match with: %s (ESC to cancel)", NULL);
+  if (rep == NULL) return;
+  find.replaced = editorReplaceAll(rep, strlen(rep));
+  free(rep);
+}
+
+// write n with thousands separators
+static void findFormatCount(char *buf, size_t size, long n) {
+  char digits[24];
+  int len = snprintf(digits, sizeof(digits), "%ld", n);
+  size_t j = 0;
+  for (int i = 0; i < len && j + 1 < size; i++) {
+    if (i > 0 && (len - i) % 3 == 0 && j + 2 < size) buf[j++] = ',';
+    buf[j++] = digits[i];
+  }
+  buf[j] = '\0';
+}
+
+// put the match count and the modes in the prompt, editorPrompt() shows it on the next frame
+static void findUpdatePrompt() {
+  char at[16], total[16], info[48];
+  if (find.reErr) {
+    snprintf(info, sizeof(info), "regex: %s", find.reErr);
+  } else if (find.nomem) {
+    snprintf(info, sizeof(info), "out of memory for the matches");
+  } else if (find.overflow) {
+    findFormatCount(total, sizeof(total), KILO_MATCH_MAX);
+    snprintf(info, sizeof(info), "over %s matches", total);
+  } else if (find.replaced) {
+    findFormatCount(total, sizeof(total), find.replaced);
+    snprintf(info, sizeof(info), "replaced %s", total);
+  } else if (find.qlen == 0) {
+    snprintf(info, sizeof(info), "Use ESC/Arrows/Enter, Ctrl-E replace");
+  } else if (find.running) {
+    long found = 0;
+    int merged = 0;
+    for (int i = 0; i < bg.ntasks; i++) {
+      if (!bg.tasks[i].merged) continue;
+      found += bg.tasks[i].count;
+      merged++;
+    }
+    findFormatCount(total, sizeof(total), found);
+    snprintf(info, sizeof(info), "searching %d%%, %s found", merged * 100 / bg.ntasks, total);
+  } else if (find.n == 0) {
+    snprintf(info, sizeof(info), "no matches");
+  } else {
+    findFormatCount(at, sizeof(at), find.current + 1);
+    findFormatCount(total, sizeof(total), find.n);
+    snprintf(info, sizeof(info), "match %s of %s", at, total);
+  }
+  // editorPrompt() uses the prompt as the format for the query, so a % of the info has to be %%
+  char escaped[sizeof(info) * 2];
+  size_t j = 0;
+  for (size_t i = 0; info[i]; i++) {
+    if (info[i] == '%') escaped[j++] = '%';
+    escaped[j++] = info[i];
+  }
+  escaped[j] = '\0';
+  snprintf(findPrompt, sizeof(findPrompt), "Search%s%s%s: %%s (%s)", findFlags & SEARCH_REGEX ? " [re]" : "",
+           findFlags & SEARCH_ICASE ? " [Aa]" : "", findFlags & SEARCH_WORD ? " [word]" : "", escaped);
+}
+
+void editorFindCallback(char *query, int key) {
+  if (key == '\r' || key == '\x1b') {
+    findReset();
+    return;
+  }
+  if (key == WAKE_EVENT) {
+    // workers finished some tasks
+    if (find.running) findCollect();
+    findUpdatePrompt();
+    return;
+  }
+  int qlen = strlen(query);
+  int direction = 0;
+  int toggled = 0;
+  if (key == ARROW_RIGHT || key == ARROW_DOWN) direction = 1;
+  else if (key == ARROW_LEFT || key == ARROW_UP) direction = -1;
+  else if (key == CTRL_KEY('c')) toggled = SEARCH_ICASE;
+  else if (key == CTRL_KEY('w')) toggled = SEARCH_WORD;
+  else if (key == CTRL_KEY('r')) toggled = SEARCH_REGEX;
+  findFlags ^= toggled;
+  if (key == CTRL_KEY('e')) {
+    findReplacePrompt();
+    findUpdatePrompt();
+    return;
+  }
+
+  if (direction == 0 && (toggled || !(find.query && qlen == find.qlen && memcmp(query, find.query, qlen) == 0))) {
+    // the query or the modes changed, whatever the workers are still doing is for the old one
+    int complete = !find.running;
+    findCancel();
+    find.replaced = 0;
+    editorIndexTo(INT_MAX); // the table covers the whole file, so it needs every row
+    // a longer query only matches where the shorter one did, but a whole word "foob" is not where the whole word "foo" was,
+    // and a longer regex may match more ("ab" then "ab*"). Only a complete table can be narrowed down
+    int extended = !toggled && !(findFlags & (SEARCH_WORD | SEARCH_REGEX)) && find.query && find.qlen > 0 && qlen > find.qlen &&
+                   !find.overflow && complete && memcmp(query, find.query, find.qlen) == 0;
+    free(find.query);
+    find.query = strdup(query);
+    if (find.query == NULL) die("strdup");
+    find.qlen = qlen;
+    regexFree(find.re);
+    find.re = NULL;
+    find.reErr = NULL;
+    if ((findFlags & SEARCH_REGEX) && qlen > 0) find.re = regexCompile(query, findFlags & (SEARCH_ICASE | SEARCH_WORD), &find.reErr);
+    find.current = -1;
+    find.jumped = 0;
+    if (qlen == 0 || find.reErr) {
+      find.n = 0;
+      find.overflow = find.nomem = 0;
+    } else if (extended) {
+      findRefine(query, qlen);
+      findJumpFirst();
+    } else {
+      findStart(KILO_MATCH_MAX); // the matches come in as WAKE_EVENT keys
+    }
+  } else if (direction != 0) {
+    if (find.running) findCollect();
+    if (find.running) {
+      // step through what the workers found so far
+      int row = find.jumped ? E.cy : find.originRow, col = find.jumped ? E.cx : find.originCol;
+      if (findStep(direction, &row, &col, 0)) {
+        find.jumped = 1;
+        findJump(row, col);
+      }
+    } else if (find.n > 0) {
+      find.current = (find.current + direction + find.n) % find.n;
+      findJump(find.list[find.current].row, find.list[find.current].col);
+    } else if (find.overflow) {
+      if (findNext(direction, &find.row, &find.col)) findJump(find.row, find.col);
+    }
+  }
+  findUpdatePrompt();
+}
+
+// number of matches of the current search, -1 when there are too many to count.
+// Waits for the workers when they are still searching
+int editorFindCount() {
+  findWait();
+  return find.overflow ? -1 : find.n;
+}
+
+void editorFind() {
+  int saved_cx = E.cx; // save the cursor position and scroll position
+  int saved_cy = E.cy;
+  int saved_coloff = E.coloff;
+  int saved_rowoff = E.rowoff;
+  findReset();
+  find.originRow = E.cy;
+  find.originCol = E.cx;
+  findUpdatePrompt();
+  char *query = editorPrompt(findPrompt, editorFindCallback);
+  if (query) {
+    free(query);
+  }else{
+    E.cx = saved_cx; //restore those values after the search is cancelled.
+    E.cy = saved_cy;
+    E.coloff = saved_coloff;
+    E.rowoff = saved_rowoff;
+  }
+}
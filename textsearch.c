@@ -0,0 +1,137 @@
+#include "kilo.h"
+
+/*** text search ***/
+/*
+The search kernel finds a needle in a buffer without a call to memmem per candidate.
+Like the line index it looks at 16 (SSE2) or 32 (AVX2) positions at once: it compares the block starting at
+each position against the first byte of the needle and the block starting nlen - 1 bytes later against its last byte,
+and only the positions where both match are checked byte by byte. In text the pair (first, last) is rare enough
+that almost every block is rejected by one vector compare.
+SEARCH_ICASE folds ASCII letters (the vector compare ORs in 0x20, which lowercases letters, the check that follows
+sorts out the other bytes that fold onto the same value), SEARCH_WORD only accepts matches with a non-word character
+(or the end of the buffer) on both sides.
+The best version the cpu supports is picked the first time textSearch() is called.
+*/
+
+static int textWordChar(unsigned char c) {
+  return isalnum(c) || c == '_';
+}
+
+// bits to OR into a text byte before comparing it with c, so both cases of a letter compare equal
+static unsigned char textFold(unsigned char c, int flags) {
+  return (flags & SEARCH_ICASE) && isalpha(c) ? 0x20 : 0;
+}
+
+// does the needle match buf at pos, taking the flags into account
+int textMatchAt(const char *buf, size_t len, size_t pos, const char *needle, size_t nlen, int flags) {
+  if (pos + nlen > len) return 0;
+  if (flags & SEARCH_ICASE) {
+    for (size_t j = 0; j < nlen; j++) {
+      if (tolower((unsigned char)buf[pos + j]) != tolower((unsigned char)needle[j])) return 0;
+    }
+  } else if (memcmp(buf + pos, needle, nlen) != 0) {
+    return 0;
+  }
+  if (flags & SEARCH_WORD) {
+    if (pos > 0 && textWordChar(buf[pos - 1])) return 0;
+    if (pos + nlen < len && textWordChar(buf[pos + nlen])) return 0;
+  }
+  return 1;
+}
+
+// plain version, memchr finds the candidates when the first byte doesn't need folding
+long textSearchScalar(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags) {
+  unsigned char first = needle[0];
+  int fold = (flags & SEARCH_ICASE) && isalpha(first);
+  for (size_t i = from; i + nlen <= len; i++) {
+    if (!fold) {
+      const char *p = memchr(buf + i, first, len - nlen + 1 - i);
+      if (p == NULL) return -1;
+      i = p - buf;
+    } else if (tolower((unsigned char)buf[i]) != tolower(first)) {
+      continue;
+    }
+    if (textMatchAt(buf, len, i, needle, nlen, flags)) return i;
+  }
+  return -1;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// check every candidate in mask, base is the position of bit 0
+#define TEXT_SEARCH_CHECK(mask, base) \
+  while (mask) { \
+    size_t pos = (base) + __builtin_ctz(mask); \
+    if (textMatchAt(buf, len, pos, needle, nlen, flags)) return pos; \
+    (mask) &= (mask) - 1; \
+  }
+
+__attribute__((target("sse2")))
+long textSearchSSE2(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags) {
+  unsigned char ff = textFold(needle[0], flags);
+  unsigned char lf = textFold(needle[nlen - 1], flags);
+  const __m128i first = _mm_set1_epi8((char)(needle[0] | ff));
+  const __m128i last = _mm_set1_epi8((char)(needle[nlen - 1] | lf));
+  const __m128i ffold = _mm_set1_epi8((char)ff);
+  const __m128i lfold = _mm_set1_epi8((char)lf);
+  size_t i = from;
+  for (; i + nlen - 1 + 16 <= len; i += 16) {
+    __m128i a = _mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + i)), ffold);
+    __m128i b = _mm_or_si128(_mm_loadu_si128((const __m128i *)(buf + i + nlen - 1)), lfold);
+    unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+    TEXT_SEARCH_CHECK(mask, i);
+  }
+  return textSearchScalar(buf, len, i, needle, nlen, flags);
+}
+
+__attribute__((target("avx2")))
+long textSearchAVX2(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags) {
+  unsigned char ff = textFold(needle[0], flags);
+  unsigned char lf = textFold(needle[nlen - 1], flags);
+  const __m256i first = _mm256_set1_epi8((char)(needle[0] | ff));
+  const __m256i last = _mm256_set1_epi8((char)(needle[nlen - 1] | lf));
+  const __m256i ffold = _mm256_set1_epi8((char)ff);
+  const __m256i lfold = _mm256_set1_epi8((char)lf);
+  size_t i = from;
+  for (; i + nlen - 1 + 32 <= len; i += 32) {
+    __m256i a = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(buf + i)), ffold);
+    __m256i b = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)(buf + i + nlen - 1)), lfold);
+    unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+    TEXT_SEARCH_CHECK(mask, i);
+  }
+  return textSearchSSE2(buf, len, i, needle, nlen, flags);
+}
+#endif
+
+static textSearchFn textSearchImpl = NULL;
+static const char *textSearchImplName = "scalar";
+
+static void textSearchPick() {
+  textSearchImpl = textSearchScalar;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    textSearchImpl = textSearchAVX2;
+    textSearchImplName = "avx2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    textSearchImpl = textSearchSSE2;
+    textSearchImplName = "sse2";
+  }
+#endif
+}
+
+// offset of the first match of needle in buf at or after from, -1 if there is none
+// the bytes before from still count for SEARCH_WORD, so a search can continue after a match
+long textSearch(const char *buf, size_t len, size_t from, const char *needle, size_t nlen, int flags) {
+  if (nlen == 0) return from <= len ? (long)from : -1;
+  if (from + nlen > len) return -1;
+  if (textSearchImpl == NULL) textSearchPick();
+  return textSearchImpl(buf, len, from, needle, nlen, flags);
+}
+
+// name of the version textSearch() uses, for the benchmark
+const char *textSearchName() {
+  if (textSearchImpl == NULL) textSearchPick();
+  return textSearchImplName;
+}
@@ -0,0 +1,317 @@
+#include "kilo.h"
+
+/*** undo ***/
+/*
+Every edit is recorded as an operation on the text: "insert these bytes at row cy, column cx" or
+"these bytes were deleted at row cy, column cx", where a '\n' in the bytes is a row boundary.
+Undo applies the opposite operation and redo the operation again, each one a single editorInsertText()
+or editorDeleteText() call, so undoing a 100K line paste costs the same as the paste did.
+A replace-all is one record too (UNDO_REPLACE): where every match was and the text it had, and the replacement,
+undo and redo each rebuild the rows it touched once with editorReplaceSpans().
+Typing and backspacing coalesce: a key that continues the previous record (same kind of edit, right
+where the last one ended) appends its byte to that record instead of making a new one, so a typed
+word is one record and costs about one byte per key.
+History is capped at KILO_UNDO_MAX bytes, the oldest records are dropped first.
+*/
+
+struct undoRecord {
+  int type; // UNDO_INSERT, UNDO_DELETE or UNDO_REPLACE
+  int cy, cx; // where the text starts
+  int ocy, ocx; // cursor before the edit, undo puts it back there
+  int newrow; // the insert started on the line past the end, so it added a row first
+  int typed; // made by a single key, later keys may coalesce into it
+  char *text; // the replacement of an UNDO_REPLACE
+  int len;
+  int cap;
+  struct replaceSpan *spans; // UNDO_REPLACE: the matches before the replace, their text points into old
+  int nspans;
+  char *old;
+  size_t oldLen;
+};
+
+static struct {
+  struct undoRecord *recs;
+  int n; // records in the log
+  int cap;
+  int pos; // records [0, pos) are applied, [pos, n) can be redone
+  size_t bytes; // memory held by the log
+  int sealed; // 1 when the next edit must start a new record
+  int applying; // 1 while undo or redo edit the text, those edits are not recorded
+} undo;
+
+static void undoFreeRecord(struct undoRecord *rec) {
+  undo.bytes -= sizeof(struct undoRecord) + rec->cap;
+  free(rec->text);
+  if (rec->spans) {
+    undo.bytes -= sizeof(struct replaceSpan) * rec->nspans + rec->oldLen;
+    free(rec->spans);
+    free(rec->old);
+  }
+}
+
+// add len bytes to the end (or the start) of the text of a record
+static void undoAddText(struct undoRecord *rec, const char *s, int len, int front) {
+  if (rec->len + len > rec->cap) {
+    int cap = rec->cap ? rec->cap : 16;
+    while (cap < rec->len + len) cap *= 2;
+    rec->text = realloc(rec->text, cap);
+    if (rec->text == NULL) die("realloc");
+    undo.bytes += cap - rec->cap;
+    rec->cap = cap;
+  }
+  if (front) {
+    memmove(rec->text + len, rec->text, rec->len);
+    memcpy(rec->text, s, len);
+  } else {
+    memcpy(rec->text + rec->len, s, len);
+  }
+  rec->len += len;
+}
+
+// row and column right after the text of a record
+static void undoEnd(struct undoRecord *rec, int *cy, int *cx) {
+  *cy = rec->cy;
+  *cx = rec->cx;
+  for (int i = 0; i < rec->len; i++) {
+    if (rec->text[i] == '\n') {
+      (*cy)++;
+      *cx = 0;
+    } else {
+      (*cx)++;
+    }
+  }
+}
+
+// try to fold a single key edit into the last record, returns 1 if it was
+static int undoCoalesce(int type, int cy, int cx, const char *s, int len) {
+  if (undo.sealed || undo.pos == 0 || undo.pos != undo.n) return 0;
+  struct undoRecord *last = &undo.recs[undo.n - 1];
+  if (!last->typed || last->type != type) return 0;
+  int ey, ex;
+  if (type == UNDO_INSERT) {
+    // a newline ends a run of typing, so undo takes back a line at a time
+    if (len == 1 && s[0] == '\n') return 0;
+    if (last->len && last->text[last->len - 1] == '\n') return 0;
+    undoEnd(last, &ey, &ex);
+    if (cy != ey || cx != ex) return 0;
+    undoAddText(last, s, len, 0);
+    return 1;
+  }
+  // backspace deletes right before the last deletion, the delete key deletes at the same place again
+  struct undoRecord probe = {0};
+  probe.cy = cy;
+  probe.cx = cx;
+  probe.text = (char *)s;
+  probe.len = len;
+  undoEnd(&probe, &ey, &ex);
+  if (ey == last->cy && ex == last->cx) {
+    undoAddText(last, s, len, 1);
+    last->cy = cy;
+    last->cx = cx;
+    return 1;
+  }
+  if (cy == last->cy && cx == last->cx) {
+    undoAddText(last, s, len, 0);
+    return 1;
+  }
+  return 0;
+}
+
+// drop the oldest records until the log fits in KILO_UNDO_MAX, the newest record always stays
+static void undoEvict() {
+  int drop = 0;
+  while (undo.bytes > KILO_UNDO_MAX && drop < undo.n - 1) undoFreeRecord(&undo.recs[drop++]);
+  if (drop == 0) return;
+  memmove(undo.recs, &undo.recs[drop], sizeof(struct undoRecord) * (undo.n - drop));
+  undo.n -= drop;
+  undo.pos -= drop;
+  if (undo.pos < 0) undo.pos = 0;
+}
+
+// start a new record at the end of the log, the caller fills in the text
+static struct undoRecord *undoNewRecord(int type, int cy, int cx) {
+  undo.sealed = 0;
+  // a new edit makes the undone records unreachable
+  while (undo.n > undo.pos) undoFreeRecord(&undo.recs[--undo.n]);
+  if (undo.n == undo.cap) {
+    undo.cap = undo.cap ? undo.cap * 2 : 64;
+    undo.recs = realloc(undo.recs, sizeof(struct undoRecord) * undo.cap);
+    if (undo.recs == NULL) die("realloc");
+  }
+  struct undoRecord *rec = &undo.recs[undo.n++];
+  memset(rec, 0, sizeof(*rec));
+  rec->type = type;
+  rec->cy = cy;
+  rec->cx = cx;
+  rec->ocy = E.cy;
+  rec->ocx = E.cx;
+  undo.bytes += sizeof(struct undoRecord);
+  undo.pos = undo.n;
+  return rec;
+}
+
+// record an edit before it is made: len bytes of text inserted or deleted at row cy, column cx
+// typed is 1 for edits made by a single key, those may be coalesced with the previous record
+void editorRecordEdit(int type, int cy, int cx, const char *s, int len, int typed) {
+  if (undo.applying) return;
+  // the rows never hold a \r, a pasted \r\n or \r is one row boundary, so store it as one \n
+  char *text = malloc(len > 0 ? len : 1);
+  if (text == NULL) die("malloc");
+  int n = 0;
+  for (int i = 0; i < len; i++) {
+    if (s[i] == '\r') {
+      text[n++] = '\n';
+      if (i + 1 < len && s[i + 1] == '\n') i++;
+    } else {
+      text[n++] = s[i];
+    }
+  }
+  int newrow = type == UNDO_INSERT && cy == E.numrows;
+  if (typed && !newrow && undoCoalesce(type, cy, cx, text, n)) {
+    free(text);
+    undoEvict();
+    return;
+  }
+  struct undoRecord *rec = undoNewRecord(type, cy, cx);
+  rec->newrow = newrow;
+  rec->typed = typed;
+  rec->text = text;
+  rec->len = n;
+  rec->cap = len > 0 ? len : 1;
+  undo.bytes += rec->cap;
+  undoEvict();
+}
+
+// record a replace-all before it is made: every span is replaced by rep
+void editorRecordReplace(struct replaceSpan *spans, int n, const char *rep, int rlen) {
+  if (undo.applying || n == 0) return;
+  // keep the text each span has now, undo puts it back
+  size_t oldLen = 0;
+  for (int i = 0; i < n; i++) oldLen += spans[i].len;
+  struct replaceSpan *saved = malloc(sizeof(struct replaceSpan) * n);
+  char *old = malloc(oldLen ? oldLen : 1);
+  char *text = malloc(rlen ? rlen : 1);
+  if (saved == NULL || old == NULL || text == NULL) die("malloc");
+  size_t at = 0;
+  erow *row = NULL;
+  for (int i = 0; i < n; i++) {
+    if (i == 0 || spans[i].row != spans[i - 1].row) {
+      row = rsAt(&E.rows, spans[i].row);
+      editorRowCloseGap(row);
+    }
+    memcpy(old + at, &row->chars[spans[i].col], spans[i].len);
+    saved[i] = spans[i];
+    saved[i].text = old + at;
+    saved[i].tlen = spans[i].len;
+    at += spans[i].len;
+  }
+  memcpy(text, rep, rlen);
+
+  struct undoRecord *rec = undoNewRecord(UNDO_REPLACE, spans[0].row, spans[0].col);
+  rec->text = text;
+  rec->len = rlen;
+  rec->cap = rlen ? rlen : 1;
+  rec->spans = saved;
+  rec->nspans = n;
+  rec->old = old;
+  rec->oldLen = oldLen;
+  undo.bytes += rec->cap + sizeof(struct replaceSpan) * n + oldLen;
+  undoEvict();
+}
+
+// apply a replace-all record, forward for redo, backward for undo
+static void undoReplace(struct undoRecord *rec, int forward) {
+  struct replaceSpan *spans = malloc(sizeof(struct replaceSpan) * rec->nspans);
+  if (spans == NULL) die("malloc");
+  int delta = 0;
+  for (int i = 0; i < rec->nspans; i++) {
+    struct replaceSpan *s = &rec->spans[i];
+    if (forward) {
+      spans[i] = *s;
+      spans[i].text = rec->text;
+      spans[i].tlen = rec->len;
+      continue;
+    }
+    // after the replace each match is rec->len long, and moved by what the matches before it in the row changed
+    if (i == 0 || s->row != rec->spans[i - 1].row) delta = 0;
+    spans[i].row = s->row;
+    spans[i].col = s->col + delta;
+    spans[i].len = rec->len;
+    spans[i].text = s->text;
+    spans[i].tlen = s->tlen;
+    delta += rec->len - s->len;
+  }
+  editorReplaceSpans(spans, rec->nspans);
+  free(spans);
+}
+
+// take back the last edit
+void editorUndo() {
+  if (undo.pos == 0) {
+    editorSetStatusMessage("Nothing to undo");
+    return;
+  }
+  struct undoRecord *rec = &undo.recs[--undo.pos];
+  undo.applying = 1;
+  if (rec->type == UNDO_REPLACE) {
+    undoReplace(rec, 0);
+  } else if (rec->type == UNDO_INSERT) {
+    editorDeleteText(rec->cy, rec->cx, rec->len);
+    if (rec->newrow) {
+      editorJournal(JOURNAL_DELROW, rec->cy, 0, NULL, 0);
+      editorDelRow(rec->cy);
+    }
+  } else {
+    E.cy = rec->cy;
+    E.cx = rec->cx;
+    editorInsertText(rec->text, rec->len);
+  }
+  undo.applying = 0;
+  undo.sealed = 1;
+  E.cy = rec->ocy;
+  E.cx = rec->ocx;
+}
+
+// make the last undone edit again
+void editorRedo() {
+  if (undo.pos == undo.n) {
+    editorSetStatusMessage("Nothing to redo");
+    return;
+  }
+  struct undoRecord *rec = &undo.recs[undo.pos++];
+  undo.applying = 1;
+  if (rec->type == UNDO_REPLACE) {
+    undoReplace(rec, 1);
+    E.cy = rec->cy;
+    E.cx = rec->cx;
+  } else if (rec->type == UNDO_INSERT) {
+    if (rec->newrow) {
+      editorJournal(JOURNAL_ROW, E.numrows, 0, NULL, 0);
+      editorInsertRow(E.numrows, "", 0);
+    }
+    E.cy = rec->cy;
+    E.cx = rec->cx;
+    editorInsertText(rec->text, rec->len);
+    // Enter on the line past the end only added a row, the cursor went down to the new line past the end
+    if (rec->newrow && rec->len == 0) E.cy++;
+  } else {
+    editorDeleteText(rec->cy, rec->cx, rec->len);
+    E.cy = rec->cy;
+    E.cx = rec->cx;
+  }
+  undo.applying = 0;
+  undo.sealed = 1;
+}
+
+// forget all history, used when the rows are thrown away
+void editorUndoClear() {
+  while (undo.n > 0) undoFreeRecord(&undo.recs[--undo.n]);
+  undo.pos = 0;
+  undo.sealed = 0;
+}
+
+// memory held by the undo log, and in *records the number of records
+size_t editorUndoBytes(int *records) {
+  if (records) *records = undo.n;
+  return undo.bytes;
+}